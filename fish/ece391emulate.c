@@ -176,6 +176,19 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+void*
+ece391_sbrk (int32_t increment)
+{
+    return sbrk (increment);
+}
+
+int32_t
+ece391_rtprio (int32_t prio)
+{
+    /* the host scheduler decides, just check the argument */
+    return (prio < 0 || prio > 31) ? -1 : 0;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
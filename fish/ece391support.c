@@ -51,3 +51,125 @@ ece391_strncmp (const uint8_t* s1, const uint8_t* s2, uint32_t n)
     return ((int32_t)*s1) - ((int32_t)*s2);
 }
 
+
+/*
+ * Heap allocator on top of ece391_sbrk.  Requests of up to 1 kB come
+ * from power-of-two size classes (16 B to 1 kB); every heap page holds
+ * blocks of one class only, so blocks carry no header and the class is
+ * read from a header at the start of their page.  Larger requests get a
+ * run of whole pages behind the same header, and freed runs are reused
+ * first-fit before the heap is grown.
+ */
+#define MALLOC_PAGE_SIZE    4096
+#define MALLOC_MIN_BLOCK    16
+#define MALLOC_NUM_CLASSES  7           /* 16, 32, ..., 1024 */
+#define MALLOC_PAGE_LARGE   0xFF        /* header of a large run */
+
+/* first MALLOC_MIN_BLOCK bytes of every page of blocks and every run */
+struct malloc_page {
+    struct malloc_page* next;   /* next free run, while on malloc_free_runs */
+    uint32_t npages;            /* length of the run, 1 for a page of blocks */
+    uint32_t cls;               /* class+1, LARGE, or 0 for a free run */
+    uint32_t pad;               /* keeps blocks MALLOC_MIN_BLOCK aligned */
+};
+
+static uint8_t* malloc_base = 0;                    /* page-aligned start of heap */
+static void* malloc_free_blocks[MALLOC_NUM_CLASSES];
+static struct malloc_page* malloc_free_runs = 0;
+
+/* Get npages contiguous pages, from a freed run if possible */
+static struct malloc_page*
+malloc_get_pages (uint32_t npages)
+{
+    struct malloc_page** prev;
+    struct malloc_page* run;
+    uint8_t* brk;
+    uint32_t pad;
+
+    for (prev = &malloc_free_runs; (run = *prev) != 0; prev = &run->next) {
+	if (run->npages == npages) {
+	    *prev = run->next;
+	    return run;
+	}
+	if (run->npages > npages) {
+	    /* split, handing out the tail of the run */
+	    run->npages -= npages;
+	    run = (struct malloc_page*)((uint8_t*)run + run->npages * MALLOC_PAGE_SIZE);
+	    run->npages = npages;
+	    return run;
+	}
+    }
+
+    if (0 == malloc_base) {
+	/* align the break so heap pages line up with real pages */
+	brk = ece391_sbrk (0);
+	if ((void*)-1 == brk)
+	    return 0;
+	pad = (MALLOC_PAGE_SIZE - ((uint32_t)brk % MALLOC_PAGE_SIZE)) % MALLOC_PAGE_SIZE;
+	if (0 != pad && (void*)-1 == ece391_sbrk (pad))
+	    return 0;
+	malloc_base = brk + pad;
+    }
+
+    brk = ece391_sbrk (npages * MALLOC_PAGE_SIZE);
+    if ((void*)-1 == brk)
+	return 0;
+    run = (struct malloc_page*)brk;
+    run->npages = npages;
+    return run;
+}
+
+void*
+ece391_malloc (uint32_t size)
+{
+    uint32_t cls, npages, i, block_size;
+    struct malloc_page* page;
+    void* block;
+
+    if (0 == size)
+	return 0;
+
+    if (size <= (MALLOC_MIN_BLOCK << (MALLOC_NUM_CLASSES - 1))) {
+	for (cls = 0; (MALLOC_MIN_BLOCK << cls) < size; cls++);
+	if (0 == malloc_free_blocks[cls]) {
+	    /* carve a fresh page into blocks of this class */
+	    if (0 == (page = malloc_get_pages (1)))
+		return 0;
+	    page->cls = cls + 1;
+	    block_size = MALLOC_MIN_BLOCK << cls;
+	    for (i = sizeof (*page); i + block_size <= MALLOC_PAGE_SIZE; i += block_size) {
+		*(void**)((uint8_t*)page + i) = malloc_free_blocks[cls];
+		malloc_free_blocks[cls] = (uint8_t*)page + i;
+	    }
+	}
+	block = malloc_free_blocks[cls];
+	malloc_free_blocks[cls] = *(void**)block;
+	return block;
+    }
+
+    npages = (size + sizeof (*page) + MALLOC_PAGE_SIZE - 1) / MALLOC_PAGE_SIZE;
+    if (0 == (page = malloc_get_pages (npages)))
+	return 0;
+    page->cls = MALLOC_PAGE_LARGE;
+    return page + 1;
+}
+
+void
+ece391_free (void* ptr)
+{
+    struct malloc_page* page;
+
+    if (0 == ptr || 0 == malloc_base || (uint8_t*)ptr < malloc_base)
+	return;
+
+    /* the heap is page-aligned, so rounding down finds the header */
+    page = (struct malloc_page*)((uint32_t)ptr & ~(MALLOC_PAGE_SIZE - 1));
+    if (MALLOC_PAGE_LARGE == page->cls && ptr == page + 1) {
+	page->cls = 0;
+	page->next = malloc_free_runs;
+	malloc_free_runs = page;
+    } else if (0 != page->cls && page->cls <= MALLOC_NUM_CLASSES) {
+	*(void**)ptr = malloc_free_blocks[page->cls - 1];
+	malloc_free_blocks[page->cls - 1] = ptr;
+    }
+}
@@ -20,5 +20,15 @@ extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 
+/* Moves the end of the heap by increment bytes and returns the old end
+ * ((void*)-1 on failure).  Pages are zero-filled on first touch. */
+extern void* ece391_sbrk (int32_t increment);
+
+/* Moves the caller to the real-time class at priority prio (1 to 31,
+ * higher first), or back to the fair class with 0.  A real-time process
+ * runs before every other one and gets the CPU as soon as the RTC read or
+ * sleep it waits in returns, so it should sleep between frames. */
+extern int32_t ece391_rtprio (int32_t prio);
+
 #endif /* ECE391SYSCALL_H */
 
@@ -18,19 +18,16 @@ uint8_t file1[] = "frame1.txt";
 extern int mp1_ioctl(unsigned long arg, unsigned long cmd);
 extern void mp1_rtc_tasklet(unsigned long trash);
 
-static struct mp1_blink_struct blink_array[80*25];
-
 int main(void)
 {
     int rtc_fd, ret_val, i, garbage;
     struct mp1_blink_struct blink_struct;
 
-    ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
-
     if(mp1_set_video_mode() == NULL) {
         return -1;
     }
 
+    ece391_rtprio(1);   // frames go out on time whatever else is running
     rtc_fd = ece391_open((uint8_t*)"rtc");
 
     add_frames(file0, file1, rtc_fd);
@@ -159,19 +156,12 @@ mp1_set_video_mode (void)
 
 void* mp1_malloc(int32_t size)
 {
-    int32_t i;
-    for(i=0; i< 80*25; i++) {
-        if(blink_array[i].location == 0) {
-            return &blink_array[i];
-        }
-    }
-
-    return NULL;
+    return ece391_malloc(size);
 }
 
 void mp1_free(void* memory)
 {
-    ece391_memset(memory, 0, sizeof(struct mp1_blink_struct));
+    ece391_free(memory);
 }
 
 void ece391_memset(void* memory, char c, int n)
@@ -0,0 +1,155 @@
+/* apic.c - Functionality for the local APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "lib.h"
+#include "pit.h"
+#include "smp.h"
+#include "scheduling.h"
+
+#define APIC_REG(reg)   (*(volatile uint32_t*)(APIC_BASE + (reg)))
+
+static uint32_t ticks_per_ms = 0;   // timer counts per millisecond, 0 until calibrated
+
+/* apic_present
+ * Inputs: none
+ * Outputs: 1 if the CPU has a local APIC, 0 otherwise
+ */
+uint32_t apic_present(void) {
+	uint32_t eax = 1, ebx, ecx, edx;
+
+	asm volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+	return (edx & CPUID_APIC) != 0;
+}
+
+/* apic_init
+ * Enables the local APIC of the running CPU
+ * Inputs: none
+ * Outputs: none
+ * Effects: accepts every vector; LINT0 keeps its reset state, so only the
+ *          boot CPU gets PIC interrupts; the timer is set up stopped
+ */
+void apic_init(void) {
+	APIC_REG(APIC_TPR) = 0;
+	APIC_REG(APIC_SVR) = APIC_SVR_ENABLE | SPURIOUS_VECTOR;
+	APIC_REG(APIC_TIMER_DIV) = APIC_DIV_16;
+	APIC_REG(APIC_LVT_TIMER) = APIC_LVT_MASKED | APIC_TIMER_VECTOR;
+	APIC_REG(APIC_TIMER_INIT) = 0;
+}
+
+/* apic_id
+ * Inputs: none
+ * Outputs: local APIC id of the running CPU
+ */
+uint32_t apic_id(void) {
+	return APIC_REG(APIC_ID) >> APIC_ID_SHIFT;
+}
+
+/* apic_eoi
+ * Signals the end of an interrupt the local APIC delivered
+ * Inputs: none
+ * Outputs: none
+ */
+void apic_eoi(void) {
+	APIC_REG(APIC_EOI) = 0;
+}
+
+/* apic_ipi
+ * Sends an inter-processor interrupt
+ * Inputs: dest - local APIC id of the receiver
+ *         icr - delivery mode, level and vector (APIC_ICR_*)
+ * Outputs: none
+ * Effects: waits until the local APIC has sent it
+ */
+void apic_ipi(uint32_t dest, uint32_t icr) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	APIC_REG(APIC_ICR_HIGH) = dest << APIC_ID_SHIFT;
+	APIC_REG(APIC_ICR_LOW) = icr;
+	while (APIC_REG(APIC_ICR_LOW) & APIC_ICR_PENDING)
+		;
+	restore_flags(flags);
+}
+
+/* apic_timer_init
+ * Enables the boot CPU's local APIC and calibrates its timer
+ * Inputs: none
+ * Outputs: none
+ * Effects: counts the timer down over CALIBRATE_US of PIT channel 2; every
+ *          CPU runs off the same bus clock, so the rate holds for all of
+ *          them. Without a local APIC the scheduler stays on the PIT.
+ */
+void apic_timer_init(void) {
+	uint32_t flags, elapsed;
+
+	if (!apic_present())
+		return;
+	apic_init();
+
+	cli_and_save(flags);
+	APIC_REG(APIC_TIMER_INIT) = TIMER_COUNT_MAX;
+	pit_delay(CALIBRATE_US);
+	elapsed = TIMER_COUNT_MAX - APIC_REG(APIC_TIMER_CUR);
+	APIC_REG(APIC_TIMER_INIT) = 0;
+	restore_flags(flags);
+
+	ticks_per_ms = elapsed / (CALIBRATE_US / 1000);
+}
+
+/* apic_timer_ready
+ * Inputs: none
+ * Outputs: 1 if the local APIC timers are calibrated, 0 to use the PIT
+ */
+uint32_t apic_timer_ready(void) {
+	return ticks_per_ms != 0;
+}
+
+/* apic_timer_oneshot
+ * Starts a one-shot count on the running CPU's timer, replacing any count in progress
+ * Inputs: us - microseconds until the interrupt, 0 to stop the timer
+ * Outputs: none
+ */
+void apic_timer_oneshot(uint32_t us) {
+	uint32_t count;
+
+	if (us == 0) {
+		APIC_REG(APIC_TIMER_INIT) = 0;
+		return;
+	}
+	// split so a long wait doesn't overflow
+	count = (us / 1000) * ticks_per_ms + (us % 1000) * ticks_per_ms / 1000;
+	if (count == 0)
+		count = 1;
+	APIC_REG(APIC_LVT_TIMER) = APIC_TIMER_VECTOR;
+	APIC_REG(APIC_TIMER_INIT) = count;
+}
+
+/* apic_timer_armed
+ * Inputs: none
+ * Outputs: 1 if the running CPU's timer is counting down
+ */
+uint32_t apic_timer_armed(void) {
+	return APIC_REG(APIC_TIMER_CUR) != 0;
+}
+
+/* apic_timer_rate
+ * Inputs: none
+ * Outputs: timer counts per millisecond, 0 before calibration
+ */
+uint32_t apic_timer_rate(void) {
+	return ticks_per_ms;
+}
+
+/* apic_timer_handler
+ * Handles the local timer of the running CPU
+ * Inputs: none
+ * Outputs: none
+ * Effects: see scheduler
+ */
+void apic_timer_handler(void) {
+	apic_eoi();
+	this_cpu()->timer_interrupts++;
+	scheduler();
+}
@@ -0,0 +1,69 @@
+/* apic.h - Defines for the local APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+/* Every CPU sees its own local APIC at the same physical address, mapped
+ * at the same virtual address by paging_init (uncached 4MB page)
+ * see https://wiki.osdev.org/APIC */
+#define APIC_BASE       0xFEE00000
+
+/* register offsets */
+#define APIC_ID         0x020
+#define APIC_TPR        0x080   // task priority, 0 accepts every vector
+#define APIC_EOI        0x0B0
+#define APIC_SVR        0x0F0   // spurious vector register
+#define APIC_ICR_LOW    0x300   // interrupt command, writing it sends the IPI
+#define APIC_ICR_HIGH   0x310   // destination APIC id in bits 31:24
+#define APIC_LVT_TIMER  0x320   // timer mode, mask and vector
+#define APIC_TIMER_INIT 0x380   // initial count, writing it starts the timer (0 stops it)
+#define APIC_TIMER_CUR  0x390   // current count, 0 once it ran out
+#define APIC_TIMER_DIV  0x3E0   // divide configuration
+
+/* register bits */
+#define APIC_SVR_ENABLE     0x100
+#define APIC_ICR_FIXED      0x00000000
+#define APIC_ICR_INIT       0x00000500
+#define APIC_ICR_STARTUP    0x00000600
+#define APIC_ICR_PENDING    0x00001000  // delivery status, set until the IPI is accepted
+#define APIC_ICR_ASSERT     0x00004000
+#define APIC_ICR_LEVEL      0x00008000
+#define APIC_ID_SHIFT       24
+#define APIC_LVT_MASKED     0x00010000  // one-shot mode unless bit 17 (periodic) is set
+#define APIC_DIV_16         0x3         // the timer counts at the bus clock / 16
+#define CPUID_APIC          0x200       // EDX bit 9 of CPUID leaf 1
+
+/* the timer is calibrated against PIT channel 2 over CALIBRATE_US */
+#define CALIBRATE_US        10000
+#define TIMER_COUNT_MAX     0xFFFFFFFF
+
+/* vectors of the local APIC, above the PIC's */
+#define APIC_TIMER_VECTOR   0xEF    // local timer, the scheduling clock of each CPU
+#define IPI_VECTOR          0xF0    // reschedule request from another CPU
+#define SPURIOUS_VECTOR     0xFF
+
+#ifndef ASM
+
+uint32_t apic_present(void);
+void apic_init(void);
+uint32_t apic_id(void);
+void apic_eoi(void);
+
+/* sends an IPI, icr is the low word of the interrupt command register */
+void apic_ipi(uint32_t dest, uint32_t icr);
+
+/* local timer - one-shot, per CPU */
+void apic_timer_init(void);
+uint32_t apic_timer_ready(void);
+void apic_timer_oneshot(uint32_t us);
+uint32_t apic_timer_armed(void);
+uint32_t apic_timer_rate(void);
+void apic_timer_handler(void);
+
+#endif
+
+#endif
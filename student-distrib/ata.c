@@ -0,0 +1,149 @@
+/* ata.c - Functionality for the ATA (IDE) disk driver
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ata.h"
+#include "lib.h"
+
+static uint32_t ata_sectors = 0;    // size of the disk, 0 if there is none
+
+static int32_t ata_wait(void);
+static void ata_select(uint32_t lba, uint32_t count);
+
+/* 
+ * ata_init
+ * Description: looks for a disk on the primary slave with IDENTIFY
+ * Inputs: n/a
+ * Outputs: number of 512 byte sectors addressable with LBA28, 0 if no disk
+ * Side-effects: turns off disk interrupts
+ */ 
+uint32_t ata_init(void)
+{
+    uint16_t id[ATA_SECTOR_WORDS];
+    int i;
+
+    outb(ATA_NIEN, ATA_CONTROL);
+    outb(ATA_SLAVE, ATA_DRIVE);
+    outb(0, ATA_COUNT);
+    outb(0, ATA_LBA_LO);
+    outb(0, ATA_LBA_MID);
+    outb(0, ATA_LBA_HI);
+    outb(ATA_CMD_IDENTIFY, ATA_COMMAND);
+
+    // a status of 0 (or a floating bus) means nothing is attached
+    if (inb(ATA_STATUS) == 0 || inb(ATA_STATUS) == 0xFF)
+        return 0;
+    while (inb(ATA_STATUS) & ATA_SR_BSY);
+    // ATAPI and SATA devices set these, they don't take ATA commands
+    if (inb(ATA_LBA_MID) || inb(ATA_LBA_HI))
+        return 0;
+    if (ata_wait() == -1)
+        return 0;
+
+    for (i = 0; i < ATA_SECTOR_WORDS; i++)
+        id[i] = inw(ATA_DATA);
+    ata_sectors = id[ATA_ID_LBA_SECTORS] | (id[ATA_ID_LBA_SECTORS + 1] << 16);
+    return ata_sectors;
+}
+
+/* 
+ * ata_read
+ * Description: reads sectors from the disk
+ * Inputs: lba - first sector
+ *         count - number of sectors (at most 255)
+ *         buf - destination, count * 512 bytes
+ * Outputs: 0 on success, -1 on error
+ * Side-effects: busy waits on the disk
+ */ 
+int32_t ata_read(uint32_t lba, uint32_t count, void* buf)
+{
+    uint16_t* words = (uint16_t*)buf;
+    uint32_t i, j;
+
+    if (lba + count > ata_sectors || count == 0 || count > 255)
+        return -1;
+
+    ata_select(lba, count);
+    outb(ATA_CMD_READ, ATA_COMMAND);
+    for (i = 0; i < count; i++) {
+        if (ata_wait() == -1)
+            return -1;
+        for (j = 0; j < ATA_SECTOR_WORDS; j++)
+            *words++ = inw(ATA_DATA);
+    }
+    return 0;
+}
+
+/* 
+ * ata_write
+ * Description: writes sectors to the disk
+ * Inputs: lba - first sector
+ *         count - number of sectors (at most 255)
+ *         buf - source, count * 512 bytes
+ * Outputs: 0 on success, -1 on error
+ * Side-effects: busy waits on the disk, flushes its write cache
+ */ 
+int32_t ata_write(uint32_t lba, uint32_t count, const void* buf)
+{
+    const uint16_t* words = (const uint16_t*)buf;
+    uint32_t i, j;
+
+    if (lba + count > ata_sectors || count == 0 || count > 255)
+        return -1;
+
+    ata_select(lba, count);
+    outb(ATA_CMD_WRITE, ATA_COMMAND);
+    for (i = 0; i < count; i++) {
+        if (ata_wait() == -1)
+            return -1;
+        for (j = 0; j < ATA_SECTOR_WORDS; j++)
+            outw(*words++, ATA_DATA);
+    }
+
+    outb(ATA_CMD_FLUSH, ATA_COMMAND);
+    while (inb(ATA_STATUS) & ATA_SR_BSY);
+    return 0;
+}
+
+/* 
+ * ata_wait
+ * Description: waits until the disk is ready to transfer a sector
+ * Inputs: n/a
+ * Outputs: 0 when data can be transferred, -1 on a disk error
+ * Side-effects: none
+ */ 
+static int32_t ata_wait(void)
+{
+    uint32_t status;
+
+    // the status register needs ~400ns to settle after a command
+    inb(ATA_CONTROL);
+    inb(ATA_CONTROL);
+    inb(ATA_CONTROL);
+    inb(ATA_CONTROL);
+
+    do {
+        status = inb(ATA_STATUS);
+        if (status & (ATA_SR_ERR | ATA_SR_DF))
+            return -1;
+    } while ((status & ATA_SR_BSY) || !(status & ATA_SR_DRQ));
+    return 0;
+}
+
+/* 
+ * ata_select
+ * Description: sets up the drive, address and sector count for a transfer
+ * Inputs: lba - first sector
+ *         count - number of sectors
+ * Outputs: n/a
+ * Side-effects: none
+ */ 
+static void ata_select(uint32_t lba, uint32_t count)
+{
+    while (inb(ATA_STATUS) & ATA_SR_BSY);
+    outb(ATA_SLAVE_LBA | ((lba >> 24) & 0x0F), ATA_DRIVE);
+    outb(count, ATA_COUNT);
+    outb(lba & 0xFF, ATA_LBA_LO);
+    outb((lba >> 8) & 0xFF, ATA_LBA_MID);
+    outb((lba >> 16) & 0xFF, ATA_LBA_HI);
+}
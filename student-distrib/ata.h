@@ -0,0 +1,52 @@
+/* ata.h - Defines for the ATA (IDE) disk driver
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+
+// reference: https://wiki.osdev.org/ATA_PIO_Mode
+// only the slave drive on the primary bus is used, the master holds the boot image
+
+/* primary bus ports */
+#define ATA_DATA        0x1F0
+#define ATA_ERROR       0x1F1
+#define ATA_COUNT       0x1F2
+#define ATA_LBA_LO      0x1F3
+#define ATA_LBA_MID     0x1F4
+#define ATA_LBA_HI      0x1F5
+#define ATA_DRIVE       0x1F6
+#define ATA_STATUS      0x1F7   // read
+#define ATA_COMMAND     0x1F7   // write
+#define ATA_CONTROL     0x3F6
+
+/* drive select values */
+#define ATA_SLAVE       0xB0    // slave, CHS (for IDENTIFY)
+#define ATA_SLAVE_LBA   0xF0    // slave, LBA (low nibble is LBA bits 24-27)
+
+/* commands */
+#define ATA_CMD_READ    0x20
+#define ATA_CMD_WRITE   0x30
+#define ATA_CMD_FLUSH   0xE7
+#define ATA_CMD_IDENTIFY 0xEC
+
+/* status bits */
+#define ATA_SR_ERR      0x01
+#define ATA_SR_DRQ      0x08
+#define ATA_SR_DF       0x20
+#define ATA_SR_BSY      0x80
+
+#define ATA_NIEN        0x02    // control register - no interrupts, the driver polls
+#define ATA_SECTOR_SIZE 512
+#define ATA_SECTOR_WORDS 256
+#define ATA_ID_LBA_SECTORS 60   // IDENTIFY word holding the 28-bit LBA sector count
+
+/* detects the disk, returns its size in sectors (0 if there is none) */
+uint32_t ata_init(void);
+/* reads/writes count sectors starting at lba, 0 on success and -1 on error */
+int32_t ata_read(uint32_t lba, uint32_t count, void* buf);
+int32_t ata_write(uint32_t lba, uint32_t count, const void* buf);
+
+#endif
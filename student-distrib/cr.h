@@ -9,6 +9,8 @@
 
 extern void enable_paging(uint32_t *);
 extern void flush_TLB();
+extern void load_page_directory(uint32_t *);
+extern uint32_t get_cr2();
 
 #endif
 
@@ -5,6 +5,8 @@
 #include "filesystem.h"
 #include "lib.h"
 #include "pcb.h"
+#include "systemcall.h"
+#include "lock.h"
 
 // reference: Appendix A (8.1) of MP3, Appendix B of MP3 for open/read/write/close behavior
 
@@ -21,6 +23,10 @@ int32_t opfile_bytes_read = -1;	/* number of bytes read through file_read */
 // flat directory structure - only directory is "."
 int32_t dir_index = 0;			/* dir_entry index of file to read in directory_read */
 
+/* guards file positions (shared by the threads of a process) and dir_index;
+ * a mutex, since copying out to a user buffer can fault and sleep */
+static mutex fs_mutex = MUTEX_INIT("fs");
+
 /*
 * filesystem_init(uint32_t fs_addr) 
 * Description: initializes the file system by setting the starting
@@ -96,6 +102,7 @@ int32_t file_write(int32_t fd, const void* buf, int32_t nbytes) {
 * Returns: number of bytes read (0 = end of the file has been reached)
 *		   -1 = fail or invalid input
 * Side Effects: increments opened file vars (inode #, bytes_read), modified contents of buf
+*				 holds fs_mutex while the position moves
 */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
 	/* input checks */
@@ -103,14 +110,18 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
 		return -1;
 	}
 
-	PCB *pcb = get_PCB();
+	PCB *pcb = MM_PCB(cur_pid);	// threads share the files of their process
 	inode_t* found_inode = (inode_t*)(inode_addr + (pcb->file_array[fd].inode*BLOCK_SIZE));
-	if(pcb->file_array[fd].file_position >= found_inode->length)
+	mutex_lock(&fs_mutex);
+	if(pcb->file_array[fd].file_position >= found_inode->length) {
+		mutex_unlock(&fs_mutex);
 		return 0; // at end of file
+	}
 	
 	int32_t bytes_read = 
 		read_data(pcb->file_array[fd].inode, pcb->file_array[fd].file_position, (uint8_t*)buf, nbytes);
 	pcb->file_array[fd].file_position += bytes_read;
+	mutex_unlock(&fs_mutex);
 
 	return bytes_read;
 }
@@ -171,7 +182,7 @@ int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes) {
 *		  nbutes - number of bytes to read
 * Outputs: writes to the buffer
 * Returns: number of bytes read/copied to the buffer, -1 on failure/invalid inputs
-* Side Effects: increments directory file index read (dir_index)
+* Side Effects: increments directory file index read (dir_index) under fs_mutex
 */
 int32_t directory_read(int32_t fd, void* buf, int32_t nbytes) {
 	if (dir_index == -1) { /* there is no directory opened */
@@ -187,13 +198,16 @@ int32_t directory_read(int32_t fd, void* buf, int32_t nbytes) {
 	/* truncate name depending on byte size  */
 	uint32_t num_bytes_to_copy; // = (nbytes < MAX_FILENAME_SIZE) ? nbytes : MAX_FILENAME_SIZE;
 	dentry_t dentry;
+	mutex_lock(&fs_mutex);
 	if (read_dentry_by_index(dir_index, &dentry) == 0) {
 		/* copy the file name into buf */
 		num_bytes_to_copy = (strlen(dentry.filename) < MAX_FILENAME_SIZE) ? strlen(dentry.filename) : MAX_FILENAME_SIZE;
 		strncpy((int8_t*)buf, dentry.filename, num_bytes_to_copy);
 		dir_index++;
+		mutex_unlock(&fs_mutex);
 		return num_bytes_to_copy;
 	}
+	mutex_unlock(&fs_mutex);
 
 	return 0;
 }
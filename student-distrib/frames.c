@@ -0,0 +1,252 @@
+/* frames.c - Functionality for the physical frame allocator
+ * vim:ts=4 noexpandtab
+ */
+
+#include "frames.h"
+#include "lib.h"
+#include "paging.h"
+
+static uint32_t frame_bitmap[FRAME_WORDS];  // 1 bit per frame, set when the frame is in use
+static uint32_t frame_hint = 0;             // bitmap word to start the next search at
+static uint32_t frames_free = 0;            // number of clear bits in the bitmap
+static uint8_t frame_refs[MAX_FRAMES];      // mappings of each frame, it is freed when this drops to 0
+static uint32_t zero_pool[ZERO_POOL_SIZE];  // allocated frames that are already cleared
+static uint32_t zero_count = 0;             // frames in zero_pool
+static uint32_t zero_hits = 0;              // zeroed allocations served from the pool
+static uint32_t zero_misses = 0;            // zeroed allocations that found it empty
+
+/* frame_init
+ * Initializes the frame pool
+ * Inputs: mem_upper - KB of memory above 1 MB (from multiboot), 0 if unknown
+ * Outputs: none
+ * Effects: marks every frame in physical memory as free and every frame
+ *          past the end of physical memory as permanently in use
+ */
+void frame_init(uint32_t mem_upper) {
+    uint32_t i;
+    uint32_t mem_end = MB_1 + mem_upper*1024;
+    uint32_t num_frames;
+
+    // clamp the pool to what is actually installed
+    if (mem_upper == 0 || mem_end > FRAME_POOL_END)
+        mem_end = FRAME_POOL_END;
+    num_frames = (mem_end > FRAME_POOL_START) ? (mem_end - FRAME_POOL_START) / FRAME_SIZE : 0;
+
+    for (i = 0; i < MAX_FRAMES; i++) {
+        frame_refs[i] = 0;
+        if (i < num_frames)
+            frame_bitmap[i / FRAME_WORD_BITS] &= ~(1 << (i % FRAME_WORD_BITS));
+        else
+            frame_bitmap[i / FRAME_WORD_BITS] |= (1 << (i % FRAME_WORD_BITS));
+    }
+    frames_free = num_frames;
+    frame_hint = 0;
+}
+
+/* frame_alloc
+ * Allocates a single 4 KB frame
+ * Inputs: none
+ * Outputs: physical address of the frame, 0 if the pool is empty
+ * Effects: frame contents are not cleared
+ */
+uint32_t frame_alloc() {
+    uint32_t i, word, bit, flags, addr;
+
+    cli_and_save(flags);
+    if (frames_free == 0) {
+        // out of memory, pre-zeroed frames are as good as any
+        addr = (zero_count > 0) ? zero_pool[--zero_count] : 0;
+        restore_flags(flags);
+        return addr;
+    }
+
+    // skip full words, starting where the last allocation left off
+    for (i = 0; i < FRAME_WORDS; i++) {
+        word = (frame_hint + i) % FRAME_WORDS;
+        if (frame_bitmap[word] != FRAME_WORD_FULL)
+            break;
+    }
+    for (bit = 0; bit < FRAME_WORD_BITS; bit++) {
+        if (!(frame_bitmap[word] & (1 << bit)))
+            break;
+    }
+
+    frame_bitmap[word] |= (1 << bit);
+    frame_refs[word*FRAME_WORD_BITS + bit] = 1;
+    frames_free--;
+    frame_hint = word;
+    restore_flags(flags);
+
+    return FRAME_POOL_START + (word*FRAME_WORD_BITS + bit)*FRAME_SIZE;
+}
+
+/* frame_ref
+ * Adds a reference to an allocated frame (for pages shared between processes)
+ * Inputs: addr - physical address of the frame
+ * Outputs: none
+ * Effects: the frame takes one more frame_free to release
+ */
+void frame_ref(uint32_t addr) {
+    uint32_t idx, flags;
+
+    if (addr < FRAME_POOL_START || addr >= FRAME_POOL_END)
+        return;
+    idx = (addr - FRAME_POOL_START) / FRAME_SIZE;
+
+    cli_and_save(flags);
+    if (frame_refs[idx] != 0)
+        frame_refs[idx]++;
+    restore_flags(flags);
+}
+
+/* frame_free
+ * Drops a reference to a frame, returning it to the pool on the last one
+ * Inputs: addr - physical address of the frame
+ * Outputs: none
+ * Effects: ignores addresses outside the pool and frames that are already free
+ */
+void frame_free(uint32_t addr) {
+    uint32_t idx, flags;
+
+    if (addr < FRAME_POOL_START || addr >= FRAME_POOL_END)
+        return;
+    idx = (addr - FRAME_POOL_START) / FRAME_SIZE;
+
+    cli_and_save(flags);
+    if (frame_refs[idx] > 1) {
+        frame_refs[idx]--;
+    }
+    else if (frame_bitmap[idx / FRAME_WORD_BITS] & (1 << (idx % FRAME_WORD_BITS))) {
+        frame_bitmap[idx / FRAME_WORD_BITS] &= ~(1 << (idx % FRAME_WORD_BITS));
+        frame_refs[idx] = 0;
+        frames_free++;
+    }
+    restore_flags(flags);
+}
+
+/* frame_alloc_large
+ * Allocates 1024 contiguous frames forming a 4 MB aligned page
+ * Inputs: none
+ * Outputs: physical address of the page, 0 if no aligned run is free
+ * Effects: page contents are not cleared
+ */
+uint32_t frame_alloc_large() {
+    uint32_t word, i, flags;
+
+    cli_and_save(flags);
+    // the pool starts 4 MB aligned, so every WORDS_PER_LARGE words is a 4 MB page
+    for (word = 0; word + WORDS_PER_LARGE <= FRAME_WORDS; word += WORDS_PER_LARGE) {
+        for (i = 0; i < WORDS_PER_LARGE; i++) {
+            if (frame_bitmap[word + i] != 0)
+                break;
+        }
+        if (i == WORDS_PER_LARGE) {
+            for (i = 0; i < WORDS_PER_LARGE; i++)
+                frame_bitmap[word + i] = FRAME_WORD_FULL;
+            for (i = 0; i < FRAMES_PER_LARGE; i++)
+                frame_refs[word*FRAME_WORD_BITS + i] = 1;
+            frames_free -= FRAMES_PER_LARGE;
+            restore_flags(flags);
+            return FRAME_POOL_START + word*FRAME_WORD_BITS*FRAME_SIZE;
+        }
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* frame_free_large
+ * Returns a 4 MB page to the pool
+ * Inputs: addr - physical address of the page
+ * Outputs: none
+ * Effects: see frame_free
+ */
+void frame_free_large(uint32_t addr) {
+    uint32_t i;
+    for (i = 0; i < FRAMES_PER_LARGE; i++)
+        frame_free(addr + i*FRAME_SIZE);
+}
+
+/* frame_free_count
+ * Inputs: none
+ * Outputs: number of frames left in the pool
+ */
+uint32_t frame_free_count() {
+    return frames_free;
+}
+
+/* frame_alloc_zeroed
+ * Takes a frame from the pre-zeroed pool
+ * Inputs: none
+ * Outputs: physical address of a cleared frame, 0 if the pool is empty
+ *          (the caller then allocates and clears one itself)
+ * Effects: counts pool hits and misses
+ */
+uint32_t frame_alloc_zeroed() {
+    uint32_t addr = 0, flags;
+
+    cli_and_save(flags);
+    if (zero_count > 0) {
+        addr = zero_pool[--zero_count];
+        zero_hits++;
+    }
+    else {
+        zero_misses++;
+    }
+    restore_flags(flags);
+    return addr;
+}
+
+/* frame_zero_refill
+ * Clears one frame into the pre-zeroed pool
+ * Inputs: none
+ * Outputs: none
+ * Effects: called from wait loops, where the process has nothing better to
+ *          do; leaves the pool alone when memory is getting low
+ */
+void frame_zero_refill() {
+    uint32_t addr, flags;
+
+    if (zero_count >= ZERO_POOL_SIZE || frames_free <= ZERO_POOL_RESERVE)
+        return;
+    if ((addr = frame_alloc()) == 0)
+        return;
+    memset((void*)PHYS_TO_VIRT(addr), 0, FRAME_SIZE);
+
+    cli_and_save(flags);
+    if (zero_count < ZERO_POOL_SIZE) {
+        zero_pool[zero_count++] = addr;
+        addr = 0;
+    }
+    restore_flags(flags);
+    if (addr)
+        frame_free(addr);   // someone else filled the pool meanwhile
+}
+
+/* frame_zero_stats
+ * Prints the pre-zeroed pool hit rate
+ * Inputs: none
+ * Outputs: none
+ * Effects: prints nothing if no zeroed frame was ever asked for
+ */
+void frame_zero_stats() {
+    uint32_t total = zero_hits + zero_misses;
+
+    if (total == 0)
+        return;
+    printf("zero pool: %d ready, %d hits, %d misses (%d%% hit rate)\n",
+        zero_count, zero_hits, zero_misses, zero_hits * 100 / total);
+}
+
+/* frame_zero_counts
+ * Reads the pre-zeroed pool's counters
+ * Inputs: hits, misses - where to store the allocations it did and didn't serve
+ * Outputs: none
+ */
+void frame_zero_counts(uint32_t* hits, uint32_t* misses) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    *hits = zero_hits;
+    *misses = zero_misses;
+    restore_flags(flags);
+}
@@ -0,0 +1,51 @@
+/* frames.h - Defines for the physical frame allocator
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FRAMES_H
+#define _FRAMES_H
+
+#include "types.h"
+
+/* frame pool - 4 KB frames handed out for user memory
+ * starts right after the kernel page, the kernel reaches each frame
+ * through its mapping at KERNEL_BASE + physical address */
+#define FRAME_POOL_START    0x00800000  // 8 MB
+#define FRAME_POOL_END      0x08000000  // 128 MB
+#define FRAME_SIZE          4096
+#define MAX_FRAMES          ((FRAME_POOL_END - FRAME_POOL_START) / FRAME_SIZE)
+#define FRAME_WORD_BITS     32
+#define FRAME_WORDS         (MAX_FRAMES / FRAME_WORD_BITS)
+#define FRAME_WORD_FULL     0xFFFFFFFF
+#define FRAMES_PER_LARGE    1024        // 4 KB frames in a 4 MB page
+#define WORDS_PER_LARGE     (FRAMES_PER_LARGE / FRAME_WORD_BITS)
+#define MB_1                0x00100000
+#define ZERO_POOL_SIZE      64          // pre-zeroed frames kept ready
+#define ZERO_POOL_RESERVE   256         // don't refill the pool below this many free frames
+
+/* frame allocator initialization, mem_upper is KB of memory above 1 MB */
+void frame_init(uint32_t mem_upper);
+
+/* returns the physical address of a free frame, 0 if none are left */
+uint32_t frame_alloc();
+/* adds a reference to a shared frame */
+void frame_ref(uint32_t addr);
+/* drops a reference to a frame, freeing it on the last one */
+void frame_free(uint32_t addr);
+/* returns the physical address of a free 4 MB aligned page, 0 if none */
+uint32_t frame_alloc_large();
+/* returns a 4 MB page to the pool */
+void frame_free_large(uint32_t addr);
+/* number of frames left in the pool */
+uint32_t frame_free_count();
+
+/* returns a pre-zeroed frame, 0 if none are ready */
+uint32_t frame_alloc_zeroed();
+/* zeroes one more frame for the pre-zeroed pool while the CPU has nothing else to do */
+void frame_zero_refill();
+/* prints how often allocations found a pre-zeroed frame */
+void frame_zero_stats();
+/* pre-zeroed pool hits and misses so far */
+void frame_zero_counts(uint32_t* hits, uint32_t* misses);
+
+#endif
@@ -5,264 +5,291 @@
 #include "handler.h"
 #include "lib.h"
 #include "systemcall.h"
+#include "paging.h"
+#include "cr.h"
+#include "signal.h"
+#include "scheduling.h"
 #define  EXCEPTION 256
 
+/* exception_raise
+ * Turns an exception into a signal for the process that caused it
+ * Inputs: ctx - registers saved on entry
+ *         signum - signal for the exception
+ * Outputs: none
+ * Effects: the signal is delivered on the return to user space; an
+ *          exception in the kernel still halts the running process
+ */
+static void exception_raise(hw_context* ctx, int32_t signum)
+{
+    if (cur_pid >= 0 && (ctx->cs & 0x3) != 0) {
+        signal_send(cur_pid, signum);
+        return;
+    }
+    halt_extend(EXCEPTION);
+}
+
 /* exception handler #0
  * Handles the exception for corresponding error (0x00)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void divide_error()
+void divide_error(hw_context* ctx)
 {
     printf("Divide Error Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_DIV_ZERO);
     // while(1);
     
 }
 
 /* exception handler #1
  * Handles the exception for corresponding error (0x01)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void debug_exc()
+void debug_exc(hw_context* ctx)
 {
     printf("Debug Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #2
  * Handles the exception for corresponding error  (0x02)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void nmi_interrupt()
+void nmi_interrupt(hw_context* ctx)
 {
     printf("Nonmaskable Interrupt\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #3
  * Handles the exception for corresponding error (0x03)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void breakpoint_exc()
+void breakpoint_exc(hw_context* ctx)
 {
     printf("Breakpoint Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #4
  * Handles the exception for corresponding error (0x04)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void overflow_exc()
+void overflow_exc(hw_context* ctx)
 {
     printf("Overflow Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #5
  * Handles the exception for corresponding error (0x05)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void bound_exceeded()
+void bound_exceeded(hw_context* ctx)
 {
     printf("Bound Range Exceeded Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 /* exception handler #6
  * Handles the exception for corresponding error (0x06)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void invalid_opcode()
+void invalid_opcode(hw_context* ctx)
 {
     printf("Invalid Opcode Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #7
  * Handles the exception for corresponding error (0x07)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void device_unavail()
+void device_unavail(hw_context* ctx)
 {
     printf("Device Not Available Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #8
  * Handles the exception for corresponding error (0x08)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void double_fault()
+void double_fault(hw_context* ctx)
 {
     printf("Double Fault Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #9
  * Handles the exception for corresponding error (0x09)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void coprocessor_seg()
+void coprocessor_seg(hw_context* ctx)
 {
     printf("Coprocessor Segment Overrun\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #10
  * Handles the exception for corresponding error (0x0A)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void invalid_tss()
+void invalid_tss(hw_context* ctx)
 {
     printf("Invalid TSS Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #11
  * Handles the exception for corresponding error (0x0B)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void segment_not_present()
+void segment_not_present(hw_context* ctx)
 {
     printf("Segment Not Present\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #12
  * Handles the exception for corresponding error (0x0C)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void stack_fault()
+void stack_fault(hw_context* ctx)
 {
     printf("Stack Fault Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #13
  * Handles the exception for corresponding error (0x0D)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void general_protection()
+void general_protection(hw_context* ctx)
 {
     printf("General Protection Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #14
  * Handles the exception for corresponding error (0x0E)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry, with the error code pushed by the processor
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: returns if the fault was resolved by demand paging,
+ *          otherwise prints error and signals SEGFAULT
  */
-void page_fault()
+void page_fault(hw_context* ctx)
 {
+    if (cur_pid >= 0)
+        sched_usage(cur_pid)->faults++;
+    if (paging_fault(get_cr2(), ctx->error_code) == 0)
+        return;
+
     printf("Page Fault Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #16
  * Handles the exception for corresponding error (0x0F)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void x87_fp_error()
+void x87_fp_error(hw_context* ctx)
 {
     printf("x87 FPU Floating-Point Error\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 /* exception handler #17
  * Handles the exception for corresponding error (0x10)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void align_check_exc()
+void align_check_exc(hw_context* ctx)
 {
     printf("Alignment Check Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #18
  * Handles the exception for corresponding error (0x11)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void machine_check_exc()
+void machine_check_exc(hw_context* ctx)
 {
     printf("Machine-Check Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #19
  * Handles the exception for corresponding error (0x12)
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void simd_fp_exc()
+void simd_fp_exc(hw_context* ctx)
 {
     printf("SIMD Floating-Point Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
 /* exception handler #15, #20-31
  * Handles the exception for other reserved errors
- * Inputs: none
+ * Inputs: ctx - registers saved on entry
  * Outputs: none
- * Effects: prints error and loops infinitely if it is a valid interrupt
+ * Effects: prints error and signals the process that caused it
  */
-void exception_default()
+void exception_default(hw_context* ctx)
 {
     printf("Non-handled Exception\n");
-    halt_extend(EXCEPTION);
+    exception_raise(ctx, SIG_SEGFAULT);
     // while(1);
 }
 
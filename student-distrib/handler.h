@@ -5,30 +5,33 @@
 #ifndef _HANDLER_H
 #define _HANDLER_H
 
+#include "types.h"
+#include "signal.h"
+
 // These are all the handlers for interrupts
-// For now, these simply print the corresponding error
-// and spin indefinitely (exceptions) or continue (other)
+// Exceptions print the corresponding error and signal the process
+// that caused them (see signal.c), other interrupts continue
 
-void divide_error();
-void debug_exc();
-void nmi_interrupt();
-void breakpoint_exc();
-void overflow_exc();
-void bound_exceeded();
-void invalid_opcode();
-void device_unavail();
-void double_fault();
-void coprocessor_seg();
-void invalid_tss();
-void segment_not_present();
-void stack_fault();
-void general_protection();
-void page_fault();
-void x87_fp_error();
-void align_check_exc();
-void machine_check_exc();
-void simd_fp_exc();
-void exception_default();
+void divide_error(hw_context* ctx);
+void debug_exc(hw_context* ctx);
+void nmi_interrupt(hw_context* ctx);
+void breakpoint_exc(hw_context* ctx);
+void overflow_exc(hw_context* ctx);
+void bound_exceeded(hw_context* ctx);
+void invalid_opcode(hw_context* ctx);
+void device_unavail(hw_context* ctx);
+void double_fault(hw_context* ctx);
+void coprocessor_seg(hw_context* ctx);
+void invalid_tss(hw_context* ctx);
+void segment_not_present(hw_context* ctx);
+void stack_fault(hw_context* ctx);
+void general_protection(hw_context* ctx);
+void page_fault(hw_context* ctx);
+void x87_fp_error(hw_context* ctx);
+void align_check_exc(hw_context* ctx);
+void machine_check_exc(hw_context* ctx);
+void simd_fp_exc(hw_context* ctx);
+void exception_default(hw_context* ctx);
 void interrupt_default();
 void system_call();
 
@@ -8,13 +8,13 @@
 #include "isr.h"
 #include "types.h"
 #include "handler.h"
+#include "apic.h"
 
 /* Kernel Data Segment*/
 #define KERNEL_SEG 0x0010
 #define PIT_NUMBER      32  // PIT at 0x20
 #define KEYBOARD_NUMBER 33  // Keyboard at 0x21
 #define RTC_NUMBER      40  // RTC at 0x28
-#define SYSCALL_NUMBER  128 // System call at 0x80
 
 /* init_idt
  * Initialize interrupt descriptor table (IDT) 
@@ -74,6 +74,11 @@ void init_idt()
 
     /* set up system call (0x80 = 128) */
     set_idt_gate(SYSCALL_NUMBER, (uint32_t)&system_call_handler, KERNEL_SEG);
+
+    /* set up interrupts from the local APIC */
+    set_idt_gate(APIC_TIMER_VECTOR, (uint32_t)&interrupt_apic_timer, KERNEL_SEG);
+    set_idt_gate(IPI_VECTOR, (uint32_t)&interrupt_ipi, KERNEL_SEG);
+    set_idt_gate(SPURIOUS_VECTOR, (uint32_t)&interrupt_spurious, KERNEL_SEG);
 }
 
 /* set_idt_gate
@@ -90,8 +95,8 @@ void set_idt_gate(uint8_t vector, uint32_t handler, uint16_t sel)
     SET_IDT_ENTRY(idt[vector], handler);
     idt[vector].seg_selector = sel;
     idt[vector].reserved4 = 0;
-    /* Use trap gates for system calls (reserved3 = 1), otherwise use interrupt gate */
-    idt[vector].reserved3 = (vector == SYSCALL_NUMBER) ? 1 : 0;  
+    /* Interrupt gates only - system calls enable interrupts once they hold the kernel lock */
+    idt[vector].reserved3 = 0;
     idt[vector].reserved2 = 1;
     idt[vector].reserved1 = 1;
     idt[vector].size = 1;
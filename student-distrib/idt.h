@@ -5,6 +5,8 @@
 #ifndef _IDT_H
 #define _IDT_H
 
+#define SYSCALL_NUMBER  128 // System call at 0x80
+
 extern void init_idt();
 void set_idt_gate(uint8_t vector, uint32_t handler, uint16_t sel);
 
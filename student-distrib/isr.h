@@ -34,6 +34,9 @@ extern void interrupt_pit();
 extern void interrupt_keyboard();
 extern void interrupt_rtc();
 extern void interrupt_handler();
+extern void interrupt_apic_timer();
+extern void interrupt_ipi();
+extern void interrupt_spurious();
 extern void system_call_handler();
 
 #endif
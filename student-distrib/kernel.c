@@ -17,6 +17,12 @@
 #include "terminals.h"
 #include "scheduling.h"
 #include "pit.h"
+#include "frames.h"
+#include "swap.h"
+#include "zswap.h"
+#include "smp.h"
+#include "apic.h"
+#include "timer.h"
 
 #define RUN_TESTS
 
@@ -30,6 +36,9 @@ void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
 
+    /* Per-CPU state of this CPU, cur_pid and cur_terminal live there */
+    smp_bsp_init();
+
     /* Clear the screen. */
     clear();
 
@@ -45,9 +54,14 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Print out the flags. */
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
 
+    /* size of memory above 1 MB, used to size the frame pool */
+    uint32_t mem_upper = 0;
+
     /* Are mem_* valid? */
-    if (CHECK_FLAG(mbi->flags, 0))
+    if (CHECK_FLAG(mbi->flags, 0)) {
         printf("mem_lower = %uKB, mem_upper = %uKB\n", (unsigned)mbi->mem_lower, (unsigned)mbi->mem_upper);
+        mem_upper = mbi->mem_upper;
+    }
 
     /* Is boot_device valid? */
     if (CHECK_FLAG(mbi->flags, 1))
@@ -147,7 +161,7 @@ void entry(unsigned long magic, unsigned long addr) {
 
         tss.ldt_segment_selector = KERNEL_LDT;
         tss.ss0 = KERNEL_DS;
-        tss.esp0 = 0x800000;
+        tss.esp0 = KERNEL_STACKS;
         ltr(KERNEL_TSS);
     }
 
@@ -160,8 +174,18 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Initialize keyboard */
     keyboard_init();
 
+    /* Find the other CPUs while the BIOS areas are still mapped */
+    smp_init();
+
     /* Initialize paging */
     paging_init(); 
+
+    /* Initialize physical frame pool */
+    frame_init(mem_upper);
+
+    /* Initialize compressed page store and swap area (if a swap disk is attached) */
+    zswap_init();
+    swap_init();
     clear();
     
     /* Initialize terminals */
@@ -173,11 +197,20 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Initialize PIT */
     pit_init(); 
 
+    /* Initialize kernel timers, the TSC is calibrated against the PIT */
+    timer_init();
+
+    /* Initialize the local APIC timer, the scheduling clock when there is one */
+    apic_timer_init();
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
 
 	/* Initialize file system */
-	filesystem_init(fs_addr);
+	filesystem_init(PHYS_TO_VIRT(fs_addr));
+
+    /* Start the other CPUs, they wait for the kernel lock */
+    smp_boot();
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
@@ -7,6 +7,9 @@
 #include "lib.h"
 #include "types.h"
 #include "terminals.h"
+#include "systemcall.h"
+#include "signal.h"
+#include "timer.h"
 
 // reference: https://wiki.osdev.org/PS/2_Keyboard, Appendix B of MP3 for open/read/write/close behavior
 
@@ -16,7 +19,6 @@ static volatile uint8_t shift_status = 0;
 static volatile uint8_t caps_status = 0;
 static volatile uint8_t ctrl_status = 0;
 static volatile uint8_t alt_status = 0;
-static volatile uint8_t enter_status = 0;
 static volatile uint8_t fn_status = 0;
 
 /* keyboard scancodes excluding numpad, arrow key, home/end section */
@@ -43,22 +45,40 @@ void keyboard_handler()
 {
     /* Read the scancode from the keyboard's data port */
 	uint8_t scancode = inb(DATA_PORT);
-    update_key_status(scancode);
     uint8_t keyval;
     int is_full = 0;
     int i;
 
+    // interrupts are disabled in the handler, so a plain spin_lock will do
+    spin_lock(&console_lock);
+    update_key_status(scancode);
+    spin_unlock(&console_lock);
+
     // change terminal on ALT-F#
     if (alt_status == 1 && fn_status != 0) {
         send_eoi(IRQ1);
         terminal_switch(fn_status-1);
     }
 
+    spin_lock(&console_lock);
+
     // clear screen on CTRL+L
     if(ctrl_status == 1 && scancode == LETTER_L) {
         clear();
     }
 
+    // interrupt the foreground process on CTRL+C, waking it if it waits for a line
+    if(ctrl_status == 1 && scancode == LETTER_C) {
+        if(terminals[display_terminal].pid != -1) {
+            signal_send(terminals[display_terminal].pid, SIG_INTERRUPT);
+            sched_wake(&terminals[display_terminal].read_wait);
+            sleep_interrupt(terminals[display_terminal].pid);
+        }
+        spin_unlock(&console_lock);
+        send_eoi(IRQ1);
+        return;
+    }
+
     if(scancode < LIMIT) { // valid keycode
         if(scancode == TAB) { // print 4 spaces for tab
             keyval = kbd_scan[UPPER][SPACE];
@@ -91,9 +111,16 @@ void keyboard_handler()
             if(!(ctrl_status == 1 && scancode == LETTER_L) && is_full != -1 && keyval != 0) { 
                 putc_keyboard(keyval); // print if valid key and added to buffer successfully
             }
+
+            // line is complete, wake up whoever is reading this terminal
+            if(keyval == '\n' && is_full != -1) {
+                terminals[display_terminal].line_ready = 1;
+                sched_wake(&terminals[display_terminal].read_wait);
+            }
         }
     }
 
+    spin_unlock(&console_lock);
     send_eoi(IRQ1);
 }
 
@@ -181,12 +208,6 @@ void update_key_status(uint8_t scancode) {
             case F3_OFF:
                     fn_status = 0;
                     break;
-            case ENTER_ON:
-                    enter_status = 1;
-                    break;
-            case ENTER_OFF:
-                    enter_status = 0;
-                    break;
             case BACKSPACE:
                 	backspace();
                     break;
@@ -222,21 +243,39 @@ int32_t terminal_open(const uint8_t* filename) {
  *         buf - buffer to store keyboard buffer
  *         nbytes - number of bytes to read
  * Output: number of bytes read
- * Effects: clears kbd_buffer
+ * Effects: clears kbd_buffer, sleeps until a line is entered
  */ 
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes) {
-    uint32_t i, j;
+    uint32_t i, j, flags;
     uint32_t found_newline = 0;
+    uint8_t line[BUF_SIZE];
     if (buf == NULL || nbytes < 0 || nbytes > BUF_SIZE) return -1;
 
-    // spin while enter is not pressed or not on display on terminal
-    while((!enter_status)||(display_terminal!=cur_terminal));
-    enter_status = 0;
+    // sleep until a line is entered on this process's terminal,
+    // or give up for a signal that kills the process
+    spin_lock_irqsave(&console_lock, flags);
+    while(!terminals[cur_terminal].line_ready) {
+        if(cur_pid >= 0 && signal_fatal(cur_pid)) {
+            spin_unlock_irqrestore(&console_lock, flags);
+            return -1;
+        }
+        spin_unlock(&console_lock);
+        sched_sleep(&terminals[cur_terminal].read_wait);
+        spin_lock(&console_lock);
+    }
+    terminals[cur_terminal].line_ready = 0;
+
+    // take the line and clear saved_kbd_buffer for the next one
+    for(j = 0; j < BUF_SIZE; j++) {
+        line[j] = saved_kbd_buffer[j];
+        saved_kbd_buffer[j] = NULL;
+    }
+    spin_unlock_irqrestore(&console_lock, flags);
     
-    // copy buffer
+    // copy buffer, outside the lock since buf can fault
     for(i = 0; (i < BUF_SIZE-1) && (i < nbytes); i++) {
-        ((int8_t*)buf)[i] =  saved_kbd_buffer[i];
-        if(saved_kbd_buffer[i] == '\n') {
+        ((int8_t*)buf)[i] =  line[i];
+        if(line[i] == '\n') {
             i++;
             found_newline = 1;
             break;
@@ -248,12 +287,6 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes) {
         i++;
     }
     
-    // copy to terminal buffer and clear saved_kbd_buffer
-    for(j = 0; j < BUF_SIZE; j++) {
-        // terminals[display_terminal].kbd_buffer[j] = saved_kbd_buffer[j];
-        saved_kbd_buffer[j] = NULL;
-    }
-    
     return i;
 }
 
@@ -343,9 +343,11 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
-	cli();
+	uint32_t flags;
 	volatile int* ptr_screen_x;
 	volatile int* ptr_screen_y;
+
+	spin_lock_irqsave(&console_lock, flags);
 	if (cur_terminal == display_terminal) {
 		video_mem = (char*)VIDEO;
 		ptr_screen_x = &screen_x;
@@ -369,13 +371,14 @@ void putc(uint8_t c) {
 		(*ptr_screen_x) %= NUM_COLS;                          // wrap x around
     }
     update_cursor(); // move cursor
-	sti();
+	spin_unlock_irqrestore(&console_lock, flags);
 }
 
-/* void putc(uint8_t c);
+/* void putc_keyboard(uint8_t c);
  * Inputs: uint_8* c = character to print
  * Return Value: void
- *  Function: Output a character to the console */
+ *  Function: Echo a typed character to the display terminal,
+ *            call with console_lock held */
 void putc_keyboard(uint8_t c) {
 	video_mem = (char*)VIDEO;
 	if (c == '\n' || c == '\r') { // move on to next line
@@ -7,7 +7,7 @@
 
 #include "types.h"
 
-#define VIDEO           0xB8000
+#define VIDEO           0xC00B8000  // video memory, as mapped above KERNEL_BASE
 #define NUM_COLS        80
 #define NUM_ROWS        25
 #define ATTRIB          0x7
@@ -131,6 +131,25 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Reads the low 32 bits of the time stamp counter (CPU cycles) */
+static inline uint32_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc"
+            : "=a"(lo), "=d"(hi)
+    );
+    return lo;
+}
+
+/* Reads the time stamp counter in units of 1024 cycles (bits 10-41),
+ * wraps after about 20 minutes at 3 GHz instead of about a second */
+static inline uint32_t rdtsc_kcycles(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc"
+            : "=a"(lo), "=d"(hi)
+    );
+    return (lo >> 10) | (hi << 22);
+}
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
@@ -0,0 +1,152 @@
+/* lock.c - Functionality for spinlocks and mutexes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "lock.h"
+#include "systemcall.h"
+
+#if LOCK_STATS
+static spinlock* lock_table[LOCK_TABLE_SIZE];	// every lock taken so far, in order of first use
+static volatile uint32_t lock_count = 0;		// entries claimed in lock_table, may pass LOCK_TABLE_SIZE
+
+/* lock_taken
+ * Counts an acquisition of a lock in its statistics
+ * Inputs: lock - lock just taken by this CPU
+ *         spins - times it waited for the lock first
+ * Outputs: none
+ * Effects: lists the lock in lock_table the first time it is taken
+ */
+static void lock_taken(spinlock* lock, uint32_t spins) {
+	uint32_t slot;
+
+	// counted while held, so no other CPU updates them at the same time
+	lock->acquired++;
+	if (spins != 0) {
+		lock->contended++;
+		lock->spins += spins;
+	}
+	if (!lock->listed) {
+		slot = 1;
+		asm volatile ("lock xaddl %0, %1" : "+r"(slot), "+m"(lock_count) : : "memory");
+		if (slot < LOCK_TABLE_SIZE)
+			lock_table[slot] = lock;
+		lock->listed = 1;
+	}
+}
+#endif
+
+/* spin_lock
+ * Takes a spinlock
+ * Inputs: lock - lock to take
+ * Outputs: none
+ * Effects: spins until no other CPU holds it
+ * Not recursive. A lock an interrupt handler takes must be taken with
+ * spin_lock_irqsave everywhere else, or the handler spins on its own CPU.
+ */
+void spin_lock(spinlock* lock) {
+	uint32_t old, spins = 0;
+
+	do {
+		while (lock->locked) {
+			asm volatile ("pause");
+			spins++;
+		}
+		old = 1;
+		asm volatile ("xchgl %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+	} while (old != 0);
+
+#if LOCK_STATS
+	lock_taken(lock, spins);
+#endif
+}
+
+/* spin_unlock
+ * Lets go of a spinlock
+ * Inputs: lock - lock held by this CPU
+ * Outputs: none
+ */
+void spin_unlock(spinlock* lock) {
+	asm volatile ("" : : : "memory");	// stores of the section happen first
+	lock->locked = 0;
+}
+
+/* spin_trylock
+ * Takes a spinlock if it is free
+ * Inputs: lock - lock to take
+ * Outputs: 1 if it was taken, 0 if another CPU holds it
+ */
+uint32_t spin_trylock(spinlock* lock) {
+	uint32_t old = 1;
+
+	// one exchange, so a CPU that takes the lock in between makes this fail
+	asm volatile ("xchgl %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+	if (old != 0)
+		return 0;
+#if LOCK_STATS
+	lock_taken(lock, 0);
+#endif
+	return 1;
+}
+
+/* mutex_lock
+ * Takes a mutex
+ * Inputs: m - mutex to take
+ * Outputs: none
+ * Effects: the calling process sleeps while another one holds it
+ * Not recursive, and never from an interrupt handler or with a spinlock held.
+ */
+void mutex_lock(mutex* m) {
+	uint32_t flags;
+
+	spin_lock_irqsave(&m->lock, flags);
+	while (m->locked) {
+#if LOCK_STATS
+		m->lock.sleeps++;
+#endif
+		spin_unlock(&m->lock);
+		sched_sleep(&m->wait);	// interrupts stay off until it sleeps
+		spin_lock(&m->lock);
+	}
+	m->locked = 1;
+	m->owner = cur_pid;
+	spin_unlock_irqrestore(&m->lock, flags);
+}
+
+/* mutex_unlock
+ * Lets go of a mutex
+ * Inputs: m - mutex the calling process holds
+ * Outputs: none
+ * Effects: wakes every waiter, the first to run gets it
+ */
+void mutex_unlock(mutex* m) {
+	uint32_t flags;
+
+	spin_lock_irqsave(&m->lock, flags);
+	m->locked = 0;
+	m->owner = -1;
+	spin_unlock(&m->lock);
+	sched_wake(&m->wait);
+	restore_flags(flags);
+}
+
+/* lock_stats_print
+ * Prints the contention of every lock taken since boot
+ * Inputs: none
+ * Outputs: none
+ * Effects: a line per lock; nothing without LOCK_STATS
+ */
+void lock_stats_print(void) {
+#if LOCK_STATS
+	uint32_t i, count = lock_count;
+	spinlock* lock;
+
+	if (count > LOCK_TABLE_SIZE)
+		count = LOCK_TABLE_SIZE;
+	for (i = 0; i < count; i++) {
+		if ((lock = lock_table[i]) == NULL)
+			continue;	// claimed but not filled in yet
+		printf("%s: %d acquired, %d contended (%d spins), %d sleeps\n", (int8_t*)lock->name,
+			lock->acquired, lock->contended, lock->spins, lock->sleeps);
+	}
+#endif
+}
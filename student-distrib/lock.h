@@ -0,0 +1,65 @@
+/* lock.h - Defines for spinlocks and mutexes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _LOCK_H
+#define _LOCK_H
+
+#include "types.h"
+#include "lib.h"
+#include "scheduling.h"
+
+/* 1 to count acquisitions and contention of every lock (see lock_stats_print), 0 for none */
+#define LOCK_STATS      0
+#define LOCK_TABLE_SIZE 32      // locks lock_stats_print can list
+
+/* busy-waiting lock, for short sections that never sleep */
+typedef struct spinlock_t {
+	volatile uint32_t locked;	// 1 while held
+	const char* name;			// for lock_stats_print
+#if LOCK_STATS
+	uint32_t acquired;			// times taken
+	uint32_t contended;			// times it had to wait for another CPU
+	uint32_t spins;				// pause loops spent waiting
+	uint32_t sleeps;			// times a mutex_lock slept on it (mutexes only)
+	uint32_t listed;			// 1 once it is in the stats table
+#endif
+} spinlock;
+
+/* sleeping lock, for sections that can block or run long */
+typedef struct mutex_t {
+	spinlock lock;				// guards locked and owner
+	volatile uint32_t locked;	// 1 while held
+	int32_t owner;				// pid holding it, -1 for none (or kernel code without a process)
+	wait_queue wait;			// processes waiting for it
+} mutex;
+
+#define SPINLOCK_INIT(lock_name)	{ .locked = 0, .name = (lock_name) }
+#define MUTEX_INIT(lock_name)		{ .lock = SPINLOCK_INIT(lock_name), .locked = 0, .owner = -1 }
+
+/* Takes a spinlock with interrupts disabled on this processor
+ * Saves EFLAGS into "flags" first, so sections can nest. Required for
+ * any lock an interrupt handler also takes. */
+#define spin_lock_irqsave(lock, flags)	\
+do {                                    \
+	cli_and_save(flags);                \
+	spin_lock(lock);                    \
+} while (0)
+
+/* Lets go of a spinlock taken with spin_lock_irqsave */
+#define spin_unlock_irqrestore(lock, flags)	\
+do {                                    \
+	spin_unlock(lock);                  \
+	restore_flags(flags);               \
+} while (0)
+
+void spin_lock(spinlock* lock);
+void spin_unlock(spinlock* lock);
+uint32_t spin_trylock(spinlock* lock);
+
+void mutex_lock(mutex* m);
+void mutex_unlock(mutex* m);
+
+void lock_stats_print(void);
+
+#endif /* _LOCK_H */
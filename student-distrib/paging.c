@@ -7,6 +7,28 @@
 #include "x86_desc.h"
 #include "cr.h"
 #include "terminals.h"
+#include "frames.h"
+#include "systemcall.h"
+#include "filesystem.h"
+#include "shm.h"
+#include "swap.h"
+#include "zswap.h"
+#include "apic.h"
+#include "scheduling.h"
+
+directory proc_directories[MAX_PROCESSES];  // page directory of each process, the kernel half is shared
+static uint32_t large_pages[MAX_PROCESSES]; // 4 MB page of a large image, 0 if using 4 KB pages
+static shared_image shared_images[SHARED_IMAGES];   // images of running executables
+static shared_image* image_owner[MAX_PROCESSES];    // shared image of each process, NULL if private
+static uint32_t evict_hand = 0;     // clock hand over the user page table entries of every process
+
+static int32_t map_user_page(uint32_t* pte);
+static void release_page(uint32_t* pte);
+static void release_range(int32_t pid, uint32_t start, uint32_t end);
+static uint32_t* evict_entry(uint32_t pos, uint32_t* step);
+static int32_t page_evict(void);
+static int32_t copy_shared_page(uint32_t* pte);
+static void share_image(int32_t pid, uint32_t inode, uint32_t first, uint32_t count);
 
 // reference: Appendix C of MP3
 
@@ -20,7 +42,7 @@
 void paging_init() {
     int i;
 
-    /* VIDEO MEMORY - FIRST 4 MB */
+    /* VIDEO MEMORY - FIRST 4 MB, AT KERNEL_BASE */
     /* VIDEO IS A SINGLE 4KB PAGE */
     // break up first 4 MB of memory into 4 KB pages
     for(i = 0; i < PAGE_LEN; i++) {
@@ -44,77 +66,597 @@ void paging_init() {
     // ps = 0; // page size is 4KB
     // g = 0; // ignored - "only set for kernel"
 
-    // first 4 MB is entry 0
-    page_directory.tables[0] = (uint32_t)video_table.pages; // page table address
-    page_directory.tables[0] |= PAGE_P;
-    page_directory.tables[0] |= PAGE_RW;
-    page_directory.tables[0] |= PAGE_PCD; // disable cache
+    /* NOT PRESENT - user space (0 to 3GB) and the rest of the kernel half */
+    // user mappings live in each process's own directory
+    for(i = 0; i < TABLE_LEN; i++) {
+        page_directory.tables[i] = 0x00000000; // mark as not present/unused 
+    }
 
-    /* KERNEL - 4MB to 8MB */
-    // next 4MB entry is entry 1 (kernel)
+    // first 4 MB of the kernel half is entry 768
+    page_directory.tables[KERNEL_PDE] = VIRT_TO_PHYS(video_table.pages); // page table address
+    page_directory.tables[KERNEL_PDE] |= PAGE_P;
+    page_directory.tables[KERNEL_PDE] |= PAGE_RW;
+    page_directory.tables[KERNEL_PDE] |= PAGE_PCD; // disable cache
+
+    /* KERNEL - 4MB to 8MB physical, linked at KERNEL_BASE + 4MB */
     // note: us is 0 (privileged/supervisor only), pcd is 0 (should cache)
-    page_directory.tables[1] = KERNEL_ADDR; // address directly to 4MB kernel page
-    page_directory.tables[1] |= PAGE_P;
-    page_directory.tables[1] |= PAGE_RW;
-    page_directory.tables[1] |= PAGE_PS; // 4MB page size
-    page_directory.tables[1] |= PAGE_G; // global for kernel
-
-    /* NOT PRESENT - 8MB TO 4GB */
-    for(i = 2; i < TABLE_LEN; i++) {
-        page_directory.tables[i] = 0x00000000; // mark as not present/unused 
+    page_directory.tables[KERNEL_PDE + 1] = KERNEL_ADDR; // address directly to 4MB kernel page
+    page_directory.tables[KERNEL_PDE + 1] |= PAGE_P;
+    page_directory.tables[KERNEL_PDE + 1] |= PAGE_RW;
+    page_directory.tables[KERNEL_PDE + 1] |= PAGE_PS; // 4MB page size
+    page_directory.tables[KERNEL_PDE + 1] |= PAGE_G; // global for kernel
+
+    /* FRAME POOL - 8MB to 128MB physical */
+    // mapped above KERNEL_BASE so the kernel can fill frames before handing them out
+    for (i = FRAME_POOL_START / MB_4; i < FRAME_POOL_END / MB_4; i++) {
+        page_directory.tables[KERNEL_PDE + i] = i * MB_4;
+        page_directory.tables[KERNEL_PDE + i] |= PAGE_P;
+        page_directory.tables[KERNEL_PDE + i] |= PAGE_RW;
+        page_directory.tables[KERNEL_PDE + i] |= PAGE_PS; // 4MB page size
+        page_directory.tables[KERNEL_PDE + i] |= PAGE_G;  // supervisor only, global like the kernel
     }
+
+    /* LOCAL APIC - mapped where it is, each CPU reaches its own there */
+    page_directory.tables[APIC_BASE / MB_4] = APIC_BASE & ~(MB_4 - 1);
+    page_directory.tables[APIC_BASE / MB_4] |= PAGE_P;
+    page_directory.tables[APIC_BASE / MB_4] |= PAGE_RW;
+    page_directory.tables[APIC_BASE / MB_4] |= PAGE_PWT;
+    page_directory.tables[APIC_BASE / MB_4] |= PAGE_PCD; // registers, never cached
+    page_directory.tables[APIC_BASE / MB_4] |= PAGE_PS;
+    page_directory.tables[APIC_BASE / MB_4] |= PAGE_G;
     
     /* ENABLE PAGING REGISTERS */
-    enable_paging(page_directory.tables);
+    // replaces the boot directory, the low identity mapping goes away
+    enable_paging((uint32_t*)VIRT_TO_PHYS(page_directory.tables));
 }
 
 /* paging_syscall
-* Memory mapping for user level programs
+* Switches to the address space of a process
 * Inputs: pid - process id
 * Outputs: none
-* Effects: flushes TLB
-* See descriptor reference and 3.7.6 of SPG for meanings of bits and rationale
-* 128 MB virtual address mapped to 8 MB or 12 MB physical address
+* Effects: loads CR3, which flushes the non-global TLB entries
+* The kernel half of every directory is the same, so kernel pointers stay
+* valid across the switch
 */
 void paging_syscall(int32_t pid) {
-	/* allocate a 4MB user page at table index 32 (from 128 MB virtual address) */
-	page_directory.tables[USER_PAGE] = (MB_8 + pid*MB_4);
-	page_directory.tables[USER_PAGE] |= PAGE_P;
-	page_directory.tables[USER_PAGE] |= PAGE_RW;
-	page_directory.tables[USER_PAGE] |= PAGE_US;
-	page_directory.tables[USER_PAGE] |= PAGE_PS;
-	
-	/* always flush TLB after changing paging mappings */
+	load_page_directory((uint32_t*)VIRT_TO_PHYS(proc_directories[pid].tables));
+}
+
+/* paging_pte
+* Finds the page table entry of a user address
+* Inputs: pid - process id
+*         addr - user virtual address
+*         create - allocate the page table if it is missing
+* Outputs: pointer to the entry, NULL if there is no page table (or no
+*          memory for one) or addr is covered by a 4MB page
+* Effects: may allocate a frame for the page table
+*/
+uint32_t* paging_pte(int32_t pid, uint32_t addr, int32_t create) {
+	uint32_t* pde = &proc_directories[pid].tables[addr / MB_4];
+	uint32_t frame;
+
+	if (addr >= KERNEL_BASE || (*pde & PAGE_PS))
+		return NULL;
+	if (!(*pde & PAGE_P)) {
+		if (!create || (frame = page_alloc_zeroed()) == 0)
+			return NULL;
+		*pde = frame;
+		*pde |= PAGE_P;
+		*pde |= PAGE_RW;
+		*pde |= PAGE_US;
+	}
+	// page tables come from the frame pool
+	return &((uint32_t*)PHYS_TO_VIRT(*pde & PAGE_MASK))[(addr % MB_4) / KB_4];
+}
+
+/* paging_load
+* Sets up the image pages of a new process and loads the executable
+* Inputs: pid - process id
+*         filename - executable to load
+* Outputs: 0 on success, -1 if out of memory
+* Effects: builds the process's page directory and switches to it
+* Images up to LARGE_IMAGE_SIZE get 4KB pages covering the file only,
+* bss pages are mapped on first touch. Larger images that fit in the
+* first 4MB of the image region get a single 4MB page when one is
+* free, anything else falls back to 4KB pages.
+* File pages of small images are shared read-only with every other
+* process running the same executable and copied on the first write.
+*/
+int32_t paging_load(int32_t pid, const uint8_t* filename) {
+	int32_t filesize = get_filesize(filename);
+	uint32_t i, frame, file_end, first, count;
+	uint32_t* pte;
+	shared_image* image;
+	dentry_t dentry;
+
+	// the image has to fit below the heap
+	if (filesize < 0 || filesize > IMAGE_END - PROGRAM_IMAGE_ADDR)
+		return -1;
+	file_end = PROGRAM_IMAGE_ADDR + filesize;
+
+	// fresh directory sharing the kernel half, user space starts out empty
+	for (i = 0; i < TABLE_LEN; i++)
+		proc_directories[pid].tables[i] = (i < KERNEL_PDE) ? 0 : page_directory.tables[i];
+
+	if (filesize > LARGE_IMAGE_SIZE) {
+		large_pages[pid] = 0;
+		image_owner[pid] = NULL;
+		// a single 4MB page, which costs more memory but only one TLB entry
+		if (file_end <= IMAGE_START + MB_4 && (frame = frame_alloc_large()) != 0) {
+			large_pages[pid] = frame;
+			proc_directories[pid].tables[IMAGE_START / MB_4] = frame;
+			proc_directories[pid].tables[IMAGE_START / MB_4] |= PAGE_P;
+			proc_directories[pid].tables[IMAGE_START / MB_4] |= PAGE_RW;
+			proc_directories[pid].tables[IMAGE_START / MB_4] |= PAGE_US;
+			proc_directories[pid].tables[IMAGE_START / MB_4] |= PAGE_PS;
+			paging_syscall(pid);
+			// the frame still holds its last owner's data, below the image as well as past it
+			memset((void*)IMAGE_START, 0, MB_4);
+			return copy_to_va(filename, PROGRAM_IMAGE_ADDR, filesize);
+		}
+	}
+
+	first = (PROGRAM_IMAGE_ADDR - IMAGE_START) / KB_4;
+	count = (file_end - IMAGE_START + KB_4 - 1) / KB_4 - first;
+	if (read_dentry_by_name(filename, &dentry) == -1)
+		return -1;
+
+	// already running somewhere, map its pages instead of loading the file again
+	for (image = shared_images; image < shared_images + SHARED_IMAGES; image++) {
+		if (!image->users || image->inode != dentry.inode_num)
+			continue;
+		for (i = 0; i < count; i++) {
+			if ((pte = paging_pte(pid, IMAGE_START + (first + i)*KB_4, 1)) == NULL) {
+				paging_free(pid);
+				return -1;
+			}
+			frame_ref(image->frames[i]);
+			*pte = image->frames[i];
+			*pte |= PAGE_P;
+			*pte |= PAGE_US;
+			*pte |= PAGE_SHARED;
+		}
+		image->users++;
+		image_owner[pid] = image;
+		paging_syscall(pid);
+		return 0;
+	}
+
+	for (i = first; i < first + count; i++) {
+		if ((pte = paging_pte(pid, IMAGE_START + i*KB_4, 1)) == NULL || (frame = page_alloc()) == 0) {
+			paging_free(pid);
+			return -1;
+		}
+		*pte = frame;
+		*pte |= PAGE_P;
+		*pte |= PAGE_RW;
+		*pte |= PAGE_US;
+	}
+	paging_syscall(pid);
+	// zero the rest of the last file page, bss may start there
+	memset((void*)file_end, 0, (KB_4 - file_end % KB_4) % KB_4);
+	if (copy_to_va(filename, PROGRAM_IMAGE_ADDR, filesize) == -1)
+		return -1;
+	if (filesize <= LARGE_IMAGE_SIZE)
+		share_image(pid, dentry.inode_num, first, count);
+	return 0;
+}
+
+/* share_image
+* Offers the freshly loaded file pages of a process to later instances
+* Inputs: pid - process id
+*         inode - inode of the executable
+*         first - page index (from IMAGE_START) of the first file page
+*         count - number of file pages
+* Outputs: none
+* Effects: makes the pages read-only (copy-on-write), flushes TLB
+* Does nothing if every slot is taken, the process keeps private pages
+*/
+static void share_image(int32_t pid, uint32_t inode, uint32_t first, uint32_t count) {
+	shared_image* image;
+	uint32_t i;
+	uint32_t* pte;
+
+	for (image = shared_images; image < shared_images + SHARED_IMAGES; image++) {
+		if (image->users == 0)
+			break;
+	}
+	if (image == shared_images + SHARED_IMAGES)
+		return;
+
+	image->users = 1;
+	image->inode = inode;
+	image->first = first;
+	image->count = count;
+	for (i = 0; i < count; i++) {
+		// the image holds its own reference so the pages stay pristine
+		pte = paging_pte(pid, IMAGE_START + (first + i)*KB_4, 0);
+		image->frames[i] = *pte & PAGE_MASK;
+		frame_ref(image->frames[i]);
+		*pte &= ~PAGE_RW;
+		*pte |= PAGE_SHARED;
+	}
+	image_owner[pid] = image;
 	flush_TLB();
 }
 
+/* paging_free
+* Releases all user memory of a process
+* Inputs: pid - process id
+* Outputs: none
+* Effects: detaches shared memory, returns every user frame and page
+*          table to the pool, flushes TLB
+*/
+void paging_free(int32_t pid) {
+	uint32_t i;
+
+	shm_detach_all(pid);
+	if (large_pages[pid]) {
+		frame_free_large(large_pages[pid]);
+		proc_directories[pid].tables[IMAGE_START / MB_4] = 0;
+		large_pages[pid] = 0;
+	}
+	release_range(pid, 0, KERNEL_BASE);
+	for (i = 0; i < KERNEL_PDE; i++) {
+		if (proc_directories[pid].tables[i] & PAGE_P)
+			frame_free(proc_directories[pid].tables[i] & PAGE_MASK);
+		proc_directories[pid].tables[i] = 0;
+	}
+	// last process running the executable drops the shared pages
+	if (image_owner[pid] != NULL && --image_owner[pid]->users == 0) {
+		for (i = 0; i < image_owner[pid]->count; i++)
+			frame_free(image_owner[pid]->frames[i]);
+	}
+	image_owner[pid] = NULL;
+}
+
+/* paging_resident
+* Resident size of a process
+* Inputs: pid - process id
+* Outputs: memory mapped by the process in KB (video page excluded)
+*/
+uint32_t paging_resident(int32_t pid) {
+	uint32_t i, j, pages = 0;
+	uint32_t* pt;
+
+	if (large_pages[pid])
+		pages += PAGE_LEN;
+	for (i = 0; i < KERNEL_PDE; i++) {
+		if (!(proc_directories[pid].tables[i] & PAGE_P) || (proc_directories[pid].tables[i] & PAGE_PS))
+			continue;
+		pt = (uint32_t*)PHYS_TO_VIRT(proc_directories[pid].tables[i] & PAGE_MASK);
+		for (j = 0; j < PAGE_LEN; j++) {
+			// the vidmap page isn't in the frame pool
+			if ((pt[j] & PAGE_P) && (pt[j] & PAGE_MASK) >= FRAME_POOL_START)
+				pages++;
+		}
+	}
+	return pages * (KB_4 / KB_1);
+}
+
 /* video_paging
-* Maps video memory into user space
+* Points the vidmap page of the running process (or its threads' process)
+* at video memory
 * Inputs: none
 * Outputs: none
 * Effects: flushes TLB
 * See descriptor reference and 3.7.6 of SPG for meanings of bits and rationale
+* Does nothing if the process never called vidmap
 */
 void video_paging() {
+	uint32_t* pte;
+
+	if (cur_pid < 0 || (pte = paging_pte(PCB_ADDR(cur_pid)->mm_pid, VIDMAP_ADDR, 0)) == NULL || !(*pte & PAGE_P))
+		return;
+
     /* page base corresponds video memory address */
     if (cur_terminal == display_terminal) {
         // running process is displayed, write to actual video memory
-        user_table.pages[0] = VIDEO_ADDR;
+        *pte = VIDEO_ADDR;
     }
 	else {
         // running process is not displayed, write to video buffer page instead
-        user_table.pages[0] = VIDEO_ADDR + KB_4*(cur_terminal+1);
+        *pte = VIDEO_ADDR + KB_4*(cur_terminal+1);
     }
-	user_table.pages[0] |= PAGE_P;
-	user_table.pages[0] |= PAGE_RW;
-	user_table.pages[0] |= PAGE_US;
-
-	/* allocate a 4 KB user page at table index 33 (from 132 MB virtual address) */
-	page_directory.tables[VIDEO_PAGE] = (uint32_t)user_table.pages;
-	page_directory.tables[VIDEO_PAGE] |= PAGE_P;
-	page_directory.tables[VIDEO_PAGE] |= PAGE_RW;
-	page_directory.tables[VIDEO_PAGE] |= PAGE_US;
+	*pte |= PAGE_P;
+	*pte |= PAGE_RW;
+	*pte |= PAGE_US;
+	*pte |= PAGE_PINNED;	// never swapped out
 
     /* always flush TLB after changing paging mappings */
 	flush_TLB();
 }
+
+/* paging_vidmap
+* Maps the vidmap page of a process
+* Inputs: pid - process id
+* Outputs: 0 on success, -1 if out of memory for the page table
+* Effects: flushes TLB
+*/
+int32_t paging_vidmap(int32_t pid) {
+	uint32_t* pte;
+
+	if ((pte = paging_pte(pid, VIDMAP_ADDR, 1)) == NULL)
+		return -1;
+	*pte = VIDEO_ADDR;
+	*pte |= PAGE_P;
+	video_paging();
+	return 0;
+}
+
+/* paging_fault
+* Maps a page of the running process on first touch (lazy zero-fill)
+* or brings it back from swap
+* Inputs: addr - faulting virtual address (CR2)
+*         error_code - error code pushed by the page fault exception
+* Outputs: 0 if the fault was handled, -1 if the access is invalid
+* Effects: allocates a frame, flushes TLB
+*/
+int32_t paging_fault(uint32_t addr, uint32_t error_code) {
+	PCB* pcb;
+	uint32_t* pte;
+
+	if (cur_pid < 0 || pid_status[cur_pid] != 1 || addr >= KERNEL_BASE)
+		return -1;
+	pcb = MM_PCB(cur_pid);	// a thread faults in its process's pages
+
+	/* protection violations are fatal, except writes to shared image pages */
+	if (error_code & PF_PROTECTION) {
+		if (!(error_code & PF_WRITE) || addr < PROGRAM_IMAGE_ADDR || addr >= IMAGE_END)
+			return -1;
+		pte = paging_pte(pcb->pid, addr, 0);
+		if (pte == NULL || !(*pte & PAGE_SHARED))
+			return -1;
+		return copy_shared_page(pte);
+	}
+
+	/* stack - grows a page at a time down to the guard page */
+	if (addr >= STACK_GUARD && addr < STACK_GUARD + KB_4) {
+		printf("Stack overflow\n");
+		return -1;
+	}
+
+	/* image region (bss past the loaded file), heap up to the current break, stack */
+	if ((addr >= PROGRAM_IMAGE_ADDR && addr < IMAGE_END) ||
+		(addr >= HEAP_START && addr < pcb->heap_brk) ||
+		(addr >= STACK_GUARD && addr < STACK_TOP)) {
+		if ((pte = paging_pte(pcb->pid, addr, 1)) == NULL)
+			return -1;
+		return map_user_page(pte);
+	}
+
+	return -1;
+}
+
+/* map_user_page
+* Backs a user page table entry with a frame, decompressed or read back
+* from swap if the page was swapped out and zeroed otherwise
+* Inputs: pte - page table entry to fill
+* Outputs: 0 on success, -1 if out of memory or the swap read failed
+* Effects: flushes TLB
+*/
+static int32_t map_user_page(uint32_t* pte) {
+	uint32_t frame;
+
+	// untouched pages come zeroed, ideally from the pre-zeroed pool
+	if (!(*pte & (PAGE_ZSWAP | PAGE_SWAPPED))) {
+		if ((frame = page_alloc_zeroed()) == 0)
+			return -1;
+		*pte = frame;
+		*pte |= PAGE_P;
+		*pte |= PAGE_RW;
+		*pte |= PAGE_US;
+		flush_TLB();
+		return 0;
+	}
+
+	if ((frame = page_alloc()) == 0)
+		return -1;
+	if (*pte & PAGE_ZSWAP) {
+		if (zswap_load(*pte / KB_4, frame) == -1) {
+			frame_free(frame);
+			return -1;
+		}
+	}
+	else {
+		if (swap_in(*pte / KB_4, PHYS_TO_VIRT(frame)) == -1) {
+			frame_free(frame);
+			return -1;
+		}
+	}
+	*pte = frame;
+	*pte |= PAGE_P;
+	*pte |= PAGE_RW;
+	*pte |= PAGE_US;
+	flush_TLB();
+	return 0;
+}
+
+/* copy_shared_page
+* Gives the process a private copy of a shared image page (copy-on-write)
+* Inputs: pte - page table entry of the shared page
+* Outputs: 0 on success, -1 if out of memory
+* Effects: flushes TLB
+*/
+static int32_t copy_shared_page(uint32_t* pte) {
+	uint32_t frame, shared = *pte & PAGE_MASK;
+
+	if ((frame = page_alloc()) == 0)
+		return -1;
+	memcpy((void*)PHYS_TO_VIRT(frame), (void*)PHYS_TO_VIRT(shared), KB_4);
+	frame_free(shared);
+	*pte = frame;
+	*pte |= PAGE_P;
+	*pte |= PAGE_RW;
+	*pte |= PAGE_US;
+	flush_TLB();
+	return 0;
+}
+
+/* heap_free_pages
+* Unmaps heap pages and returns their frames to the pool
+* Inputs: pid - process id
+*         from - first heap address to release (rounded up to a page)
+* Outputs: none
+* Effects: flushes TLB
+*/
+void heap_free_pages(int32_t pid, uint32_t from) {
+	release_range(pid, (from + KB_4 - 1) & PAGE_MASK, HEAP_START + HEAP_MAX);
+}
+
+/* release_range
+* Unmaps the pages of an address range
+* Inputs: pid - process id
+*         start - first address (page aligned)
+*         end - end of the range (4MB aligned)
+* Outputs: none
+* Effects: skips missing page tables, flushes TLB
+*/
+static void release_range(int32_t pid, uint32_t start, uint32_t end) {
+	uint32_t addr;
+	uint32_t* pte;
+
+	for (addr = start; addr < end; addr += KB_4) {
+		if ((pte = paging_pte(pid, addr, 0)) == NULL) {
+			addr = (addr & ~(MB_4 - 1)) + MB_4 - KB_4;	// next page table
+			continue;
+		}
+		release_page(pte);
+	}
+	flush_TLB();
+}
+
+/* release_page
+* Frees whatever backs a user page table entry and clears it
+* Inputs: pte - page table entry
+* Outputs: none
+* Effects: returns the frame to the pool or releases the swap slot
+*/
+static void release_page(uint32_t* pte) {
+	if (*pte & PAGE_P)
+		frame_free(*pte & PAGE_MASK);
+	else if (*pte & PAGE_ZSWAP)
+		zswap_free(*pte / KB_4);
+	else if (*pte & PAGE_SWAPPED)
+		swap_free(*pte / KB_4);
+	*pte = 0;
+}
+
+/* page_alloc
+* Allocates a frame for user memory
+* Inputs: none
+* Outputs: physical address of the frame, 0 if memory and swap are both full
+* Effects: may write other pages out to swap, frame contents are not cleared
+*/
+uint32_t page_alloc(void) {
+	uint32_t frame;
+
+	while ((frame = frame_alloc()) == 0) {
+		if (page_evict() == -1)
+			return 0;
+	}
+	return frame;
+}
+
+/* page_alloc_zeroed
+* Allocates a cleared frame for user memory
+* Inputs: none
+* Outputs: physical address of the frame, 0 if memory and swap are both full
+* Effects: takes a pre-zeroed frame if one is ready, otherwise clears one
+*/
+uint32_t page_alloc_zeroed(void) {
+	uint32_t frame;
+
+	if ((frame = frame_alloc_zeroed()) != 0)
+		return frame;
+	if ((frame = page_alloc()) != 0)
+		memset((void*)PHYS_TO_VIRT(frame), 0, KB_4);
+	return frame;
+}
+
+/* page_evict
+* Compresses one cold user page into the in-memory store, or writes it out
+* to swap if it doesn't compress, and frees its frame
+* Inputs: none
+* Outputs: 0 if a page was moved out, -1 if nothing could be
+* Effects: clears accessed bits, flushes TLB
+* Clock over the private image, heap and stack pages of every process. The
+* first sweep looks for a page that is neither accessed nor dirty, the next
+* one takes any unaccessed page and clears the accessed bits it passes, so
+* a page survives as long as it is touched once per revolution. Shared
+* image and shared memory pages are never swapped out.
+* A page whose frame starts a new compressed pool frame frees nothing, the
+* caller just evicts again (the next page then fits next to it).
+*/
+static int32_t page_evict(void) {
+	uint32_t total = MAX_PROCESSES * KERNEL_PDE * PAGE_LEN;
+	uint32_t pass, n, step, frame;
+	int32_t slot, kept;
+	uint32_t* pte;
+
+	for (pass = 0; pass < 3; pass++) {
+		for (n = 0; n < total; n += step) {
+			pte = evict_entry(evict_hand, &step);
+			evict_hand = (evict_hand + step) % total;
+			if (pte == NULL)
+				continue;
+			if (*pte & PAGE_A) {
+				if (pass > 0)
+					*pte &= ~PAGE_A;
+				continue;
+			}
+			if (pass == 0 && (*pte & PAGE_D))
+				continue;
+
+			frame = *pte & PAGE_MASK;
+			if ((slot = zswap_store(frame, &kept)) != -1) {
+				*pte = slot * KB_4;
+				*pte |= PAGE_ZSWAP;
+				if (!kept)
+					frame_free(frame);
+			}
+			else if ((slot = swap_out(PHYS_TO_VIRT(frame))) != -1) {
+				*pte = slot * KB_4;
+				*pte |= PAGE_SWAPPED;
+				frame_free(frame);
+			}
+			else {
+				continue;	// keep looking for a page that compresses
+			}
+			flush_TLB();
+			return 0;
+		}
+		flush_TLB();	// accessed bits must be set again by the next access
+	}
+	return -1;
+}
+
+/* evict_entry
+* Page table entry under the clock hand
+* Inputs: pos - clock position (pid, user directory entry, table entry)
+*         step - set to how far the hand can move on, past the rest of a
+*                dead process or a missing page table
+* Outputs: the entry if it maps a private page of a live process, NULL otherwise
+* A process running on another CPU is skipped, that CPU's TLB would keep
+* the page (see sched_mm_busy).
+*/
+static uint32_t* evict_entry(uint32_t pos, uint32_t* step) {
+	uint32_t pid = pos / (KERNEL_PDE * PAGE_LEN);
+	uint32_t pde = (pos / PAGE_LEN) % KERNEL_PDE;
+	uint32_t i = pos % PAGE_LEN;
+	uint32_t* pte;
+
+	*step = 1;
+	if (pid_status[pid] != 1 || sched_mm_busy(pid)) {
+		*step = (KERNEL_PDE - pde) * PAGE_LEN - i;
+		return NULL;
+	}
+	if (!(proc_directories[pid].tables[pde] & PAGE_P) || (proc_directories[pid].tables[pde] & PAGE_PS)) {
+		*step = PAGE_LEN - i;
+		return NULL;
+	}
+	pte = &((uint32_t*)PHYS_TO_VIRT(proc_directories[pid].tables[pde] & PAGE_MASK))[i];
+	if (!(*pte & PAGE_P) || (*pte & (PAGE_SHARED | PAGE_PINNED)))
+		return NULL;
+	return pte;
+}
@@ -6,6 +6,7 @@
 #define _PAGING_H
 
 #include "types.h"
+#include "x86_desc.h"
 
 /* constants */
 #define PAGE_LEN    1024        // 1kb
@@ -22,17 +23,40 @@
 #define PAGE_D           64   // dirty                    0 0100 0000
 #define PAGE_PS          128  // page size                0 1000 0000
 #define PAGE_G           256  // global                   1 0000 0000
-#define KERNEL_ADDR 0x00400000  // kernel memory address
-#define VIDEO_ADDR  0x000B8000  // video memory address
+#define PAGE_SHARED      512  // (software) shared image 10 0000 0000
+#define PAGE_SWAPPED     1024 // (software) in swap, address bits hold the slot
+#define PAGE_PINNED      1024 // (software) present and never swapped out
+#define PAGE_ZSWAP       2048 // (software) compressed, address bits hold the handle
+#define KERNEL_ADDR 0x00400000  // kernel memory address (physical)
+#define VIDEO_ADDR  0x000B8000  // video memory address (physical)
 #define VIDEO_LOCATION  184     // (B8000=753664)/4096 = 0xB8
-#define USER_PAGE		32		// user program is at 128MB (128/4=32)
-#define VIDEO_PAGE      33      // video page is at 132MB (right after user page)
+#define KERNEL_PDE      (KERNEL_BASE / MB_4)    // first kernel directory entry (768), user space is below
+#define KERNEL_STACKS   (KERNEL_BASE + MB_8)    // kernel stacks and PCBs grow down from here
 #define MB_8		0x00800000
 #define MB_4		0x00400000
 #define KB_8		0x2000
 #define MB_128      0x8000000
-#define MB_132      0x8400000
-#define MB_136      0x8800000
+#define IMAGE_START     MB_128      // program image region, a 4MB page for large images
+#define IMAGE_END       0x10000000  // 256 MB
+#define HEAP_START      IMAGE_END   // first address of the heap
+#define HEAP_MAX        0x40000000  // heap can grow to 1 GB
+#define SHM_START       0x60000000  // first address of the shared memory window
+#define VIDMAP_ADDR     0x70000000  // video memory page for user (vidmap)
+#define STACK_TOP       KERNEL_BASE // stack grows down from here
+#define STACK_MAX       MB_8        // largest stack, including the guard page
+#define STACK_GUARD     (STACK_TOP - STACK_MAX) // lowest stack page, never mapped so overflows fault
+#define PAGE_MASK       0xFFFFF000  // physical address bits of a page entry
+#define LARGE_IMAGE_SIZE    0x00100000  // images over 1MB are loaded into a 4MB page
+#define SHARED_IMAGES   8       // executables whose pages can be shared at once
+
+/* kernel virtual address of physical memory below 128MB and back */
+#define PHYS_TO_VIRT(addr)  ((uint32_t)(addr) + KERNEL_BASE)
+#define VIRT_TO_PHYS(addr)  ((uint32_t)(addr) - KERNEL_BASE)
+
+/* page fault error code bits */
+#define PF_PROTECTION    1    // fault on a present page (otherwise page not present)
+#define PF_WRITE         2    // fault caused by a write
+#define PF_USER          4    // fault occurred in user mode
 
 /* directory and table structs */
 // may have to add additional structs over time
@@ -48,17 +72,45 @@ typedef struct table_t {
     uint32_t pages[PAGE_LEN] __attribute__((aligned(KB_4)));
 } table;
 
-directory page_directory;
+// file pages of an executable, mapped read-only into every process running it
+typedef struct shared_image_t {
+    int32_t users;      // processes using the image, 0 if the slot is free
+    uint32_t inode;     // inode of the executable
+    uint32_t first;     // page index (from IMAGE_START) of the first file page
+    uint32_t count;     // number of file pages
+    uint32_t frames[LARGE_IMAGE_SIZE / KB_4];
+} shared_image;
+
+directory page_directory;   // kernel half, copied into every process's directory
 table video_table;
-table user_table;
 
 /* paging initialization */
 extern void paging_init();
 
-/* virtual memory mapping for syscall execute */
+/* switches to the page directory of a process */
 void paging_syscall(int32_t pid);
+/* maps and loads the image of a new process */
+int32_t paging_load(int32_t pid, const uint8_t* filename);
+/* releases all user memory of a process */
+void paging_free(int32_t pid);
+/* allocates a frame for user memory, swapping out a page if the pool is empty */
+uint32_t page_alloc(void);
+/* same, but the frame is cleared */
+uint32_t page_alloc_zeroed(void);
+/* page table entry of a user address, the table is allocated if create is set */
+uint32_t* paging_pte(int32_t pid, uint32_t addr, int32_t create);
+/* resident size of a process in KB */
+uint32_t paging_resident(int32_t pid);
 
-/* paging setup for virtual memory */
+/* points the vidmap page of the running process at its terminal's video memory */
 void video_paging();
+/* maps the vidmap page of a process */
+int32_t paging_vidmap(int32_t pid);
+
+/* demand paging - maps a page on first touch, 0 if handled */
+int32_t paging_fault(uint32_t addr, uint32_t error_code);
+
+/* unmaps and frees heap pages of pid at and above address from */
+void heap_free_pages(int32_t pid, uint32_t from);
 
 #endif
@@ -9,6 +9,7 @@
 
 #define FDA_SIZE 8
 #define MAX_ARG_SEQ_SIZE 32
+#define PCB_NAME_SIZE 33    // a file name (up to 32 characters) and its '\0'
 
 #ifndef ASM
 
@@ -34,7 +35,6 @@ typedef struct PCB_t {
     // store stack addresses for control switching
     // DO NOT MOVE OR CHANGE ORDER
     // if the process is a parent, esp/ebp stores the esp/ebp of the child process on execute
-    // if the process has no child, esp/ebp stores the esp/ebp on terminal switch
     uint32_t esp;   // esp to jump back to
     uint32_t ebp;   // ebp to jump back to
     uint32_t eip;   // eip of current process on execute (entrypoint of current user program)
@@ -48,14 +48,39 @@ typedef struct PCB_t {
 
 	// executable arguments
 	uint8_t exe_args[MAX_ARG_SEQ_SIZE];
+	// program it runs, for getrusage
+	uint8_t name[PCB_NAME_SIZE];
 
 	// process id
 	uint32_t pid;
     // terminal which process is running in
     uint32_t tid;
+
+    // end of the heap (first address past it), moved by sbrk
+    uint32_t heap_brk;
+
+    // kernel esp saved by context_switch while the process is off the CPU
+    uint32_t ctx_esp;
+
+    // 1 if no parent waits in execute for it (pipeline stages but the last, threads)
+    uint32_t detached;
+
+    // process whose address space, heap and files this one uses,
+    // its own pid unless it is a thread
+    uint32_t mm_pid;
+    // user esp a thread starts on
+    uint32_t user_esp;
+
+    // process that collects the exit status with waitpid, -1 if none (see spawn)
+    int32_t waiter;
+    // status it halted with, kept until waitpid collects it
+    int32_t exit_status;
 } PCB;
 
 extern PCB* get_PCB();
+/* saves the running kernel context in *save_esp and resumes the one at load_esp,
+ * setting the TSS esp0 unless it is 0 */
+extern void context_switch(uint32_t* save_esp, uint32_t load_esp, uint32_t esp0);
 
 #endif
 
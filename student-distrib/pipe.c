@@ -0,0 +1,245 @@
+/* pipe.c - Functionality for pipes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pipe.h"
+#include "lib.h"
+#include "paging.h"
+#include "frames.h"
+#include "systemcall.h"
+
+static pipe_t pipes[MAX_PIPES];
+
+file_ops pipe_read_fops = {NULL, pipe_read, NULL, pipe_close_read};
+file_ops pipe_write_fops = {NULL, NULL, pipe_write, pipe_close_write};
+
+static void pipe_free(pipe_t* p);
+
+/* pipe
+ * Creates a pipe in the current process
+ * Inputs: fds - where to store the read end (fds[0]) and write end (fds[1])
+ * Outputs: 0 on success, -1 on failure
+ * Effects: takes two file descriptors
+ */
+int32_t pipe(int32_t* fds) {
+	PCB *pcb = MM_PCB(cur_pid);
+	int32_t rfd, wfd, idx;
+
+	if (fds == NULL || (uint32_t)fds >= KERNEL_BASE - 2*sizeof(int32_t))
+		return -1;
+
+	for (rfd = FD_MIN; rfd <= FD_MAX && pcb->file_array[rfd].flags != NOT_IN_USE; rfd++);
+	for (wfd = rfd + 1; wfd <= FD_MAX && pcb->file_array[wfd].flags != NOT_IN_USE; wfd++);
+	if (wfd > FD_MAX || (idx = pipe_create()) == -1)
+		return -1;
+
+	pipe_attach(cur_pid, rfd, idx, PIPE_READ_END);
+	pipe_attach(cur_pid, wfd, idx, PIPE_WRITE_END);
+	fds[0] = rfd;
+	fds[1] = wfd;
+	return 0;
+}
+
+/* pipe_create
+ * Allocates an empty pipe with no ends attached
+ * Inputs: none
+ * Outputs: index of the pipe, -1 if there is no free pipe or memory
+ * Effects: allocates the buffer frames
+ */
+int32_t pipe_create(void) {
+	uint32_t i, flags;
+	int32_t idx;
+
+	cli_and_save(flags);
+	for (idx = 0; idx < MAX_PIPES; idx++) {
+		if (pipes[idx].frames[0] == 0)
+			break;
+	}
+	if (idx == MAX_PIPES) {
+		restore_flags(flags);
+		return -1;
+	}
+
+	for (i = 0; i < PIPE_PAGES; i++) {
+		if ((pipes[idx].frames[i] = frame_alloc()) == 0) {
+			pipe_free(&pipes[idx]);
+			restore_flags(flags);
+			return -1;
+		}
+	}
+	pipes[idx].head = 0;
+	pipes[idx].count = 0;
+	pipes[idx].readers = 0;
+	pipes[idx].writers = 0;
+	restore_flags(flags);
+	return idx;
+}
+
+/* pipe_release
+ * Frees a pipe that never had an end attached
+ * Inputs: idx - pipe from pipe_create
+ * Outputs: none
+ * Effects: none if an end is attached
+ */
+void pipe_release(int32_t idx) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if (pipes[idx].readers == 0 && pipes[idx].writers == 0)
+		pipe_free(&pipes[idx]);
+	restore_flags(flags);
+}
+
+/* pipe_attach
+ * Makes a file descriptor of a process one end of a pipe
+ * Inputs: pid - process
+ *         fd - descriptor to replace, its old file is dropped without closing
+ *              (meant for the stdin/stdout of a process that hasn't run yet)
+ *         idx - pipe
+ *         end - PIPE_READ_END or PIPE_WRITE_END
+ * Outputs: none
+ */
+void pipe_attach(int32_t pid, int32_t fd, int32_t idx, int32_t end) {
+	open_file* file = &PCB_ADDR(pid)->file_array[fd];
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if (end == PIPE_READ_END) {
+		file->fops_table = pipe_read_fops;
+		pipes[idx].readers++;
+	}
+	else {
+		file->fops_table = pipe_write_fops;
+		pipes[idx].writers++;
+	}
+	file->inode = idx;
+	file->file_position = 0;
+	file->flags = 1;
+	restore_flags(flags);
+}
+
+/* pipe_read
+ * Reads from the read end of a pipe
+ * Inputs: fd - file descriptor
+ *         buf - buffer to fill
+ *         nbytes - size of buf
+ * Outputs: bytes read, 0 once the buffer is empty and every write end is closed
+ * Effects: sleeps until there is data, wakes writers waiting for room
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes) {
+	pipe_t* p = &pipes[MM_PCB(cur_pid)->file_array[fd].inode];
+	uint32_t flags, off, chunk;
+	int32_t done = 0;
+
+	cli_and_save(flags);
+	while (p->count == 0 && p->writers > 0)
+		sched_sleep(&p->read_wait);
+
+	// copy a page at a time, stopping at the end of a buffer page
+	while (done < nbytes && p->count > 0) {
+		off = p->head % KB_4;
+		chunk = KB_4 - off;
+		if (chunk > p->count)
+			chunk = p->count;
+		if (chunk > nbytes - done)
+			chunk = nbytes - done;
+		memcpy((uint8_t*)buf + done, (void*)(PHYS_TO_VIRT(p->frames[p->head / KB_4]) + off), chunk);
+		p->head = (p->head + chunk) % PIPE_SIZE;
+		p->count -= chunk;
+		done += chunk;
+	}
+	sched_wake(&p->write_wait);
+	restore_flags(flags);
+	return done;
+}
+
+/* pipe_write
+ * Writes to the write end of a pipe
+ * Inputs: fd - file descriptor
+ *         buf - data to write
+ *         nbytes - size of buf
+ * Outputs: nbytes, bytes written before the read end closed, -1 if it
+ *          was closed before anything was written
+ * Effects: sleeps while the buffer is full, wakes waiting readers
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes) {
+	pipe_t* p = &pipes[MM_PCB(cur_pid)->file_array[fd].inode];
+	uint32_t flags, tail, off, chunk;
+	int32_t done = 0;
+
+	cli_and_save(flags);
+	while (done < nbytes) {
+		while (p->count == PIPE_SIZE && p->readers > 0)
+			sched_sleep(&p->write_wait);
+		if (p->readers == 0)
+			break;
+
+		tail = (p->head + p->count) % PIPE_SIZE;
+		off = tail % KB_4;
+		chunk = KB_4 - off;
+		if (chunk > PIPE_SIZE - p->count)
+			chunk = PIPE_SIZE - p->count;
+		if (chunk > nbytes - done)
+			chunk = nbytes - done;
+		memcpy((void*)(PHYS_TO_VIRT(p->frames[tail / KB_4]) + off), (const uint8_t*)buf + done, chunk);
+		p->count += chunk;
+		done += chunk;
+		sched_wake(&p->read_wait);
+	}
+	restore_flags(flags);
+	return (done == 0 && nbytes > 0) ? -1 : done;
+}
+
+/* pipe_close_read
+ * Closes a read end
+ * Inputs: fd - file descriptor
+ * Outputs: 0
+ * Effects: writers waiting for room fail, frees the pipe after the last end
+ */
+int32_t pipe_close_read(int32_t fd) {
+	pipe_t* p = &pipes[MM_PCB(cur_pid)->file_array[fd].inode];
+	uint32_t flags;
+
+	cli_and_save(flags);
+	p->readers--;
+	sched_wake(&p->write_wait);
+	if (p->readers == 0 && p->writers == 0)
+		pipe_free(p);
+	restore_flags(flags);
+	return 0;
+}
+
+/* pipe_close_write
+ * Closes a write end
+ * Inputs: fd - file descriptor
+ * Outputs: 0
+ * Effects: readers see end of file once the buffer drains, frees the pipe
+ *          after the last end
+ */
+int32_t pipe_close_write(int32_t fd) {
+	pipe_t* p = &pipes[MM_PCB(cur_pid)->file_array[fd].inode];
+	uint32_t flags;
+
+	cli_and_save(flags);
+	p->writers--;
+	sched_wake(&p->read_wait);
+	if (p->readers == 0 && p->writers == 0)
+		pipe_free(p);
+	restore_flags(flags);
+	return 0;
+}
+
+/* pipe_free
+ * Returns the buffer of a pipe to the frame pool
+ * Inputs: p - pipe
+ * Outputs: none
+ * Effects: marks the pipe free
+ */
+static void pipe_free(pipe_t* p) {
+	uint32_t i;
+
+	for (i = 0; i < PIPE_PAGES; i++) {
+		frame_free(p->frames[i]);
+		p->frames[i] = 0;
+	}
+}
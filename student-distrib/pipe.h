@@ -0,0 +1,43 @@
+/* pipe.h - Defines for pipes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "scheduling.h"
+
+#define MAX_PIPES       16                  // pipes that can exist at once
+#define PIPE_PAGES      4                   // buffer of each pipe is 16 KB
+#define PIPE_SIZE       (PIPE_PAGES * 4096)
+#define PIPE_READ_END   0
+#define PIPE_WRITE_END  1
+
+// ring buffer between the write end and the read end of a pipe
+typedef struct pipe_t {
+	uint32_t frames[PIPE_PAGES];    // buffer pages, 0 if the pipe is free
+	uint32_t head;                  // offset of the oldest byte
+	uint32_t count;                 // bytes buffered
+	int32_t readers;                // open read ends
+	int32_t writers;                // open write ends
+	wait_queue read_wait;           // readers waiting for data
+	wait_queue write_wait;          // writers waiting for room
+} pipe_t;
+
+/* system call 16 */
+int32_t pipe(int32_t* fds);
+
+/* pipe creation for execute, the pipe is freed once both ends were
+ * attached and closed (or right away by pipe_release if never attached) */
+int32_t pipe_create(void);
+void pipe_release(int32_t idx);
+void pipe_attach(int32_t pid, int32_t fd, int32_t idx, int32_t end);
+
+/* file operations of the two ends */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t pipe_close_read(int32_t fd);
+int32_t pipe_close_write(int32_t fd);
+
+#endif
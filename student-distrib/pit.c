@@ -7,29 +7,105 @@
 #include "lib.h"
 #include "scheduling.h"
 #include "i8259.h"
+#include "timer.h"
+
+static volatile uint32_t armed = 0;         // 1 while a one-shot count is running
+static volatile uint32_t interrupts = 0;    // PIT interrupts since boot
 
 /* pit_init
  * Initializes programmable interval timer (PIT)
  * Inputs: n/a
  * Return Value: n/a
  * Effects: sets interval frequency and enables interrupt requests
+ * When TICKLESS, the PIT stays stopped until the scheduler arms it.
  */
 void pit_init() {
+#if TICKLESS
+    outb(MODE_ONESHOT, MODE_REG);           // counter waits for a count
+#else
     // set frequency mode and value
     outb(MODE, MODE_REG);                   // initialize mode/cmd register to MODE
     outb(RELOAD_VAL & BYTE_MASK, CHANNEL0); // set low byte of reload value
     outb(RELOAD_VAL >> 8, CHANNEL0);        // right shift to set high byte of reload value
+#endif
     // enable irq
     enable_irq(PIT_IRQ);
 }
 
 /* pit_handler
- * Handles interrupt requests and calls scheduler
+ * Handles interrupt requests, fires due kernel timers and calls scheduler
  * Inputs: n/a
  * Return Value: n/a
- * Effects: see scheduler
+ * Effects: see timer_run and scheduler
  */
 void pit_handler() {
     send_eoi(PIT_IRQ);
+    interrupts++;
+    armed = 0;
+    timer_run();
     scheduler();
 }
+
+/* pit_oneshot
+ * Starts a one-shot count, replacing any count in progress
+ * Inputs: count - PIT cycles until the interrupt (1193182 per second),
+ *                 0 to stop the timer
+ * Return Value: n/a
+ * Effects: none with a periodic tick
+ */
+void pit_oneshot(uint16_t count) {
+#if TICKLESS
+    uint32_t flags;
+
+    cli_and_save(flags);
+    outb(MODE_ONESHOT, MODE_REG);           // writing the mode stops the counter
+    if (count != 0) {
+        outb(count & BYTE_MASK, CHANNEL0);
+        outb(count >> 8, CHANNEL0);
+    }
+    armed = (count != 0);
+    restore_flags(flags);
+#endif
+}
+
+/* pit_armed
+ * Inputs: n/a
+ * Return Value: 1 if an interrupt is coming, always with a periodic tick
+ */
+uint32_t pit_armed() {
+    return TICKLESS ? armed : 1;
+}
+
+/* pit_interrupts
+ * Inputs: n/a
+ * Return Value: PIT interrupts since boot
+ */
+uint32_t pit_interrupts() {
+    return interrupts;
+}
+
+/* pit_delay
+ * Waits a number of microseconds
+ * Inputs: us - time to wait
+ * Return Value: n/a
+ * Effects: polls channel 2, so it works with interrupts disabled and
+ *          leaves channel 0 (the scheduler's) alone
+ */
+void pit_delay(uint32_t us) {
+    uint32_t chunk, count;
+
+    while (us > 0) {
+        chunk = (us > DELAY_MAX_US) ? DELAY_MAX_US : us;
+        count = chunk * (FREQ / 1000) / 1000;
+        if (count == 0)
+            count = 1;
+
+        outb((inb(SPEAKER_PORT) & ~SPEAKER_DATA) | SPEAKER_GATE2, SPEAKER_PORT);
+        outb(MODE_CH2_ONESHOT, MODE_REG);   // output goes low until the count runs out
+        outb(count & BYTE_MASK, CHANNEL2);
+        outb(count >> 8, CHANNEL2);
+        while (!(inb(SPEAKER_PORT) & SPEAKER_OUT2))
+            ;
+        us -= chunk;
+    }
+}
@@ -12,7 +12,7 @@
  *
  * MODE[7:6] = 00 for channel 0
  * MODE[5:4] = 11 for lobyte/hibyte to send reload_val (transfer as pair)
- * MODE[3:1] = 011 for square wave generator
+ * MODE[3:1] = 011 for square wave generator, 000 for interrupt on terminal count
  * MODE[0] = 0 for 16-bit binary
  * 
  * frequency = 1193182 / reload_value [Hz] = 50 Hz = tick every 20 ms
@@ -21,11 +21,34 @@
 #define CHANNEL0    0x40   // channel 0 allows timer ticks
 #define MODE_REG    0x43   // port of mode/command register
 #define MODE        0x36   // square wave generator
+#define MODE_ONESHOT 0x30  // interrupt on terminal count, counts once then stops
 #define BYTE_MASK   0xFF
 #define FREQ        1193182 // frequency base
 #define RELOAD_VAL  23864
+#define SLICE_COUNT RELOAD_VAL  // one-shot count of a scheduler slice (20 ms)
+
+/* channel 2 (the speaker's) is polled for short busy waits, its gate and
+ * output are bits of the speaker port */
+#define CHANNEL2        0x42
+#define MODE_CH2_ONESHOT 0xB0  // channel 2, lobyte/hibyte, interrupt on terminal count
+#define SPEAKER_PORT    0x61
+#define SPEAKER_GATE2   0x01   // channel 2 counts while set
+#define SPEAKER_DATA    0x02   // speaker on, kept off
+#define SPEAKER_OUT2    0x20   // channel 2 output, set at terminal count
+#define DELAY_MAX_US    50000  // longest wait a 16-bit count holds
+
+/* 1 to only interrupt when a slice is up (one-shot), 0 for a periodic 50 Hz tick */
+#define TICKLESS    1
 
 void pit_init();
 void pit_handler();
 
+/* one-shot timer - count of 0 stops it */
+void pit_oneshot(uint16_t count);
+uint32_t pit_armed();
+uint32_t pit_interrupts();
+
+/* busy waits on channel 2, without interrupts */
+void pit_delay(uint32_t us);
+
 #endif
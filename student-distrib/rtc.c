@@ -5,9 +5,21 @@
 #include "rtc.h"
 #include "i8259.h"
 #include "lib.h"
+#include "scheduling.h"
+#include "signal.h"
+#include "systemcall.h"
+#include "timer.h"
 
 // reference: https://wiki.osdev.org/RTC, Appendix B of MP3 for open/read/write/close behavior
 
+static wait_queue rtc_wait;     // processes blocked in rtc_read
+static int32_t rtc_freq = F2;   // interrupts per second
+static volatile uint32_t rtc_ticks = 0;     // interrupts since boot
+static volatile uint32_t rtc_kcycles;       // rdtsc_kcycles at the last interrupt
+static rtc_jitter jitter[MAX_PROCESSES];    // per pid, see rtc_read
+
+static void rtc_jitter_reset(int32_t pid);
+
 /* 
  * rtc_handler 
  * Description: handles rtc interrupt by turning the periodic interrupt on
@@ -19,15 +31,17 @@ void rtc_handler()
 {
     send_eoi(RTC_IRQ_NUM); // interrupt acknowledged
 
-    int i;
-    for(i = 0; i < MAX_TERMINALS; i++) {
-        rtc_int_flag[i] = 1;
-    }
+    rtc_kcycles = rdtsc_kcycles();
+    rtc_ticks++;
+    sched_wake(&rtc_wait); // readers wait for the next interrupt
+    signal_tick(1000000 / rtc_freq);
     // test_interrupts();
 
     // if reg C not read, interrupt will not happen again
     outb(RTC_REG_C, NMI_PORT); // select reg C and disable NMI
     inb(CMOS_PORT);            // throw away contents
+
+    sched_preempt();           // a real-time reader runs right away
     return;
 }
 
@@ -51,11 +65,6 @@ void rtc_init()
     // set initial freq to 2
     rtc_set_freq(F2);
 
-    int i = 0;
-    for(i = 0; i < MAX_TERMINALS; i++) {
-        rtc_int_flag[i] = 0;
-    }
-
     return;
 }
 
@@ -91,6 +100,7 @@ int32_t rtc_set_freq(int32_t freq) {
     outb(RTC_REG_A, NMI_PORT);       // reset index to A
     outb((prev & REG_A_MASK) | freq_reg, CMOS_PORT);  // write rate to reg A (rate is bottom 4 bits)
     // prev & 0xF0 = zero out lower 4 bits, keep higher 4 bits
+    rtc_freq = freq;
     
     return 0;
 }
@@ -100,25 +110,58 @@ int32_t rtc_set_freq(int32_t freq) {
  * Description: resets rtc frequency 
  * Inputs: filename - n/a
  * Outputs: 0 on success
- * Side-effects: sets rtc frequency to 2 Hz
+ * Side-effects: starts measuring the jitter of the caller's reads afresh
  */
 int32_t rtc_open(const uint8_t* filename) {
+    if (cur_pid >= 0)
+        rtc_jitter_reset(cur_pid);
     return 0;
 }
 
 /* 
  * rtc_read
- * Description: reads interrupt and resets interrupt flag 
+ * Description: blocks until the next interrupt
  * Inputs: fd - file descriptor, n/a
  *         buf - n/a
  *         nbytes - n/a
  * Outputs: 0 on success, -1 otherwise
- * Side-effects: sends frequency to rtc specified port if valid
+ * Side-effects: sleeps on rtc_wait, the CPU goes to other processes;
+ *               measures how late the caller got the CPU back
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
-    rtc_int_flag[cur_terminal] = 0;
-    while (!rtc_int_flag[cur_terminal]); // wait for rtc interrupt
-    rtc_int_flag[cur_terminal] = 0;
+    uint32_t flags, now, tick, latency, period, expected, off;
+    rtc_jitter* j;
+
+    cli_and_save(flags);
+    sched_sleep(&rtc_wait);     // other processes run until the next interrupt
+    now = rdtsc_kcycles();
+    tick = rtc_ticks;
+    latency = timer_kcycles_us(now - rtc_kcycles);
+
+    if (cur_pid >= 0) {
+        j = &jitter[cur_pid];
+        if (j->freq != rtc_freq)
+            rtc_jitter_reset(cur_pid);  // another process changed it
+        j->samples++;
+        j->latency_total += latency;
+        if (latency > j->latency_max)
+            j->latency_max = latency;
+        // only consecutive interrupts have a known period between them
+        if (j->last_tick != 0 && tick == j->last_tick + 1) {
+            period = timer_kcycles_us(now - j->last_kcycles);
+            expected = 1000000 / rtc_freq;
+            off = (period > expected) ? period - expected : expected - period;
+            j->jitter_total += off;
+            if (off > j->jitter_max)
+                j->jitter_max = off;
+        }
+        else if (j->last_tick != 0 && tick > j->last_tick) {
+            j->missed += tick - j->last_tick - 1;
+        }
+        j->last_tick = tick;
+        j->last_kcycles = now;
+    }
+    restore_flags(flags);
     return 0;
 }
 
@@ -139,7 +182,11 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
     // set frequency
     int32_t freq;
     freq = *((int32_t*)buf);
-    return rtc_set_freq(freq);
+    if (rtc_set_freq(freq) == -1)
+        return -1;
+    if (cur_pid >= 0)
+        rtc_jitter_reset(cur_pid);
+    return 0;
 }
 
 /* 
@@ -151,3 +198,52 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
 int32_t rtc_close(int32_t fd) {
     return 0;
 }
+
+/* 
+ * rtc_jitter_reset
+ * Description: starts measuring a process's reads afresh
+ * Inputs: pid - process
+ * Outputs: n/a
+ */
+static void rtc_jitter_reset(int32_t pid) {
+    rtc_jitter* j = &jitter[pid];
+
+    memset(j, 0, sizeof(rtc_jitter));
+    j->freq = rtc_freq;
+}
+
+/* 
+ * rtc_jitter_get
+ * Description: copies out the jitter measured for a process
+ * Inputs: pid - process
+ *         out - where to copy it
+ * Outputs: 0 on success, -1 for a bad pid
+ */
+int32_t rtc_jitter_get(int32_t pid, rtc_jitter* out) {
+    uint32_t flags;
+
+    if (pid < 0 || pid >= MAX_PROCESSES || out == NULL)
+        return -1;
+    cli_and_save(flags);
+    *out = jitter[pid];
+    restore_flags(flags);
+    return 0;
+}
+
+/* 
+ * rtc_jitter_print
+ * Description: prints the jitter measured for a process
+ * Inputs: pid - process
+ * Outputs: n/a
+ * Side-effects: latency is from the interrupt to the read returning,
+ *               jitter how far the time between two reads was off 1 / freq
+ */
+void rtc_jitter_print(int32_t pid) {
+    rtc_jitter j;
+
+    if (rtc_jitter_get(pid, &j) == -1 || j.samples == 0)
+        return;
+    printf("pid %d at %d Hz: %d reads, latency avg %d max %d us, jitter avg %d max %d us, %d ticks missed\n",
+        pid, j.freq, j.samples, j.latency_total / j.samples, j.latency_max,
+        (j.samples > 1) ? j.jitter_total / (j.samples - 1) : 0, j.jitter_max, j.missed);
+}
@@ -47,9 +47,19 @@
 #define RS512        7
 #define RS1024       6
 
-/* flag to check next interrupt */ 
-// volatile int32_t rtc_int_flag; // set to 1 when RTC interrupt occurs
-volatile int32_t rtc_int_flag[MAX_TERMINALS];
+
+/* how promptly a process's rtc_read returns after each interrupt */
+typedef struct rtc_jitter_t {
+    uint32_t freq;              // RTC frequency while it was measured
+    uint32_t last_tick;         // interrupt the last read returned after, 0 before the first
+    uint32_t last_kcycles;      // rdtsc_kcycles when it returned
+    uint32_t samples;           // reads measured
+    uint32_t missed;            // interrupts that passed while the process was busy
+    uint32_t latency_total;     // us from interrupt to return, summed
+    uint32_t latency_max;
+    uint32_t jitter_total;      // us between consecutive returns was off from 1 / freq, summed
+    uint32_t jitter_max;
+} rtc_jitter;
 
 /* rtc initialization */ 
 void rtc_init(void);
@@ -66,4 +76,8 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 /* close system call (always returns 0/success) */
 int32_t rtc_close(int32_t fd);
 
+/* jitter of a process's reads since it opened the RTC or changed its frequency */
+int32_t rtc_jitter_get(int32_t pid, rtc_jitter* out);
+void rtc_jitter_print(int32_t pid);
+
 #endif
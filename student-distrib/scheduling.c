@@ -4,93 +4,898 @@
 
 #include "scheduling.h"
 #include "types.h"
+#include "lib.h"
 #include "pit.h"
 #include "terminals.h"
 #include "paging.h"
 #include "x86_desc.h"
 #include "systemcall.h"
 #include "i8259.h"
+#include "frames.h"
+#include "smp.h"
+#include "apic.h"
+#include "lock.h"
+#include "timer.h"
+
+/* per CPU, indexed by this_cpu()->id */
+static int32_t run_queue[MAX_CPUS][MAX_PROCESSES];  // runnable processes waiting for the CPU, oldest first
+static uint32_t rq_count[MAX_CPUS];         // entries in run_queue
+static uint32_t last_charge[MAX_CPUS];      // rdtsc_kcycles when the running process was last charged
+static uint32_t last_acct[MAX_CPUS];        // rdtsc_kcycles of the last sched_acct
+static uint32_t idle_stack[MAX_CPUS][IDLE_STACK_SIZE / 4];
+static uint32_t idle_esp[MAX_CPUS];         // saved context of the idle task, 0 before it first runs
+static volatile uint8_t idling[MAX_CPUS];   // 1 while the idle task has the CPU
+static uint32_t busy_time[MAX_CPUS];        // SCHED_UNITs the CPU spent outside the idle task
+static uint32_t idle_time[MAX_CPUS];        // SCHED_UNITs the CPU spent in the idle task
+static uint32_t rt_period[MAX_CPUS];        // rdtsc_kcycles when the current real-time budget period began
+static uint32_t rt_used[MAX_CPUS];          // SCHED_UNITs real-time processes ran in it
+static uint8_t rt_throttled[MAX_CPUS];      // 1 once they used up SCHED_RT_RUNTIME of it
+
+static sched_task tasks[MAX_PROCESSES];     // fair share state of each pid
+static uint32_t min_vruntime = 0;           // lowest vruntime of a runnable process, never goes back
+static uint32_t launch_stacks[MAX_TERMINALS][LAUNCH_STACK_SIZE / 4];
+static uint32_t discarded_esp;              // context_switch target when nothing is saved
+static volatile uint8_t sleeping[MAX_PROCESSES];    // 1 while a process waits on a wait queue
+
+/* guards the run queues, tasks, min_vruntime, sleeping, the wait queues'
+ * bits and pid_status; the per CPU state above is only touched by its own CPU */
+spinlock sched_lock = SPINLOCK_INIT("sched");
+
+/* weight of each nice level from -20 to 19, every level is about 10% more
+ * or less CPU than the next (the table Linux uses) */
+static const uint32_t nice_weights[NICE_MAX - NICE_MIN + 1] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+    9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45, 36, 29, 23, 18, 15
+};
+
+static uint32_t bench_stack[BENCH_STACK_SIZE / 4];
+static uint32_t bench_esp;                  // saved context of bench_partner
+static uint32_t bench_main_esp;             // saved context of sched_bench
+
+static void sched_switch(int32_t next, uint32_t* save_esp);
+static uint32_t sched_frame(uint32_t* top, void (*entry)(void));
+static void bench_partner(void);
+static int32_t sched_min(uint32_t cpu);
+static int32_t sched_order(int32_t a, int32_t b);
+static uint32_t sched_rt(int32_t pid);
+static void rq_add(int32_t pid);
+static int32_t rq_take(uint32_t cpu, int32_t idx);
+static void sched_tick_others(void);
+static void sched_idle(uint32_t* save_esp);
+static void idle_task(void);
+static void launch_shell(void);
 
 /* scheduler
- * Round Robin scheduling
+ * Fair share scheduling over the run queue, below a real-time class
  * Inputs: n/a
  * Return Value: n/a
- * Effects: switches the running process to the next terminal's process
- *          changes video and process paging, as well as the stack pointers
+ * Effects: charges the running process for its time, then switches to the
+ *          runnable process that comes first (see sched_order) if that
+ *          isn't the running one, changing paging, the TSS and the kernel
+ *          stack; a real-time process keeps the CPU until it sleeps, one
+ *          with a higher priority wakes or the real-time budget runs out
+ * Called from the local APIC timer of each CPU, which only interrupts when
+ * a slice is up (see sched_timer). On the PIT fallback the boot CPU passes
+ * its ticks on to the others by IPI. Processes blocked in execute waiting for
+ * a child or sleeping on a wait queue are not on the queue, so every
+ * runnable process gets a share no matter which terminal it belongs to.
  */
 void scheduler() {
-    uint8_t next_tid;
-    int cur_pid;
-
-    cur_pid = terminals[cur_terminal].pid;
-
-    /* return if pit interrupt occurs at first terminal launch before shell has been executed */
-    if (cur_pid == -1)
-        return; 
-
-    /* find next terminal to process (round-robin cycle) */
-    next_tid = (cur_terminal+1) % MAX_TERMINALS;
-    while (terminals[next_tid].running_processes == 0 || terminals[next_tid].pid == -1) {
-        // skip terminal if no processes running
-        next_tid = (next_tid+1) % MAX_TERMINALS;
-        if (next_tid == cur_terminal) {
-            // return if finished looping around and no other terminal processes running
-            return;
+    uint32_t cpu = this_cpu()->id;
+    int32_t next, i, order;
+
+    sched_charge();
+    if (cpu == CPU_BSP && !apic_timer_ready())
+        sched_tick_others();
+
+    /* nothing to switch away from before the first shell or while a process halts */
+    if (cur_pid < 0 || pid_status[cur_pid] != 1) {
+        sched_timer();
+        return;
+    }
+
+    spin_lock(&sched_lock);     // interrupts are already disabled
+    // keep running while still behind everyone else, first in first out among real-time equals
+    if ((i = sched_min(cpu)) < 0 ||
+        (order = sched_order(cur_pid, run_queue[cpu][i])) < 0 ||
+        (order == 0 && sched_rt(cur_pid) != 0)) {
+        spin_unlock(&sched_lock);
+        sched_timer();
+        return;
+    }
+
+    next = rq_take(cpu, i);
+    rq_add(cur_pid);
+    spin_unlock(&sched_lock);
+    tasks[cur_pid].usage.nivcsw++;
+    sched_switch(next, &PCB_ADDR(cur_pid)->ctx_esp);
+}
+
+/* sched_enqueue
+ * Adds a process to the back of the running CPU's run queue
+ * Inputs: pid - runnable process
+ * Return Value: n/a
+ * Effects: none if the queue is full (can't happen, one entry per pid);
+ *          kicks an idle CPU, which steals the process if this one is busy
+ */
+void sched_enqueue(int32_t pid) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    rq_add(pid);
+    spin_unlock(&sched_lock);
+    sched_timer();      // the running process now has to share
+    restore_flags(flags);
+}
+
+/* rq_add
+ * Adds a process to the back of the running CPU's run queue
+ * Inputs: pid - runnable process
+ * Return Value: n/a
+ * Effects: see sched_enqueue
+ * Call with sched_lock held.
+ */
+static void rq_add(int32_t pid) {
+    uint32_t cpu = this_cpu()->id;
+    uint32_t i;
+
+    if (rq_count[cpu] < MAX_PROCESSES)
+        run_queue[cpu][rq_count[cpu]++] = pid;
+    for (i = 0; i < num_cpus; i++) {
+        if (i != cpu && cpus[i].online && idling[i]) {
+            smp_kick(i);
+            break;
+        }
+    }
+}
+
+/* sched_dequeue
+ * Takes the process with the lowest vruntime off the running CPU's run queue
+ * Inputs: n/a
+ * Return Value: pid, -1 if there is nothing this CPU can run
+ * Effects: ties go to the process that was queued first; with nothing of
+ *          its own the CPU steals from the CPU with the longest queue
+ */
+int32_t sched_dequeue(void) {
+    uint32_t flags, cpu, victim, i;
+    int32_t idx, j, pid = -1;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    cpu = this_cpu()->id;
+    victim = cpu;
+    if ((idx = sched_min(cpu)) < 0) {
+        for (i = 0; i < num_cpus; i++) {
+            if (i == cpu || rq_count[i] == 0 || (idx >= 0 && rq_count[i] <= rq_count[victim]))
+                continue;
+            if ((j = sched_min(i)) >= 0) {
+                victim = i;
+                idx = j;
+            }
+        }
+    }
+    if (idx >= 0)
+        pid = rq_take(victim, idx);
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return pid;
+}
+
+/* rq_take
+ * Takes an entry off a run queue
+ * Inputs: cpu - whose run queue
+ *         idx - index in it
+ * Return Value: pid of the entry
+ * Call with sched_lock held.
+ */
+static int32_t rq_take(uint32_t cpu, int32_t idx) {
+    int32_t pid = run_queue[cpu][idx];
+
+    for (rq_count[cpu]--; idx < rq_count[cpu]; idx++)
+        run_queue[cpu][idx] = run_queue[cpu][idx + 1];
+    return pid;
+}
+
+/* sched_remove
+ * Takes a process off the CPUs' books for good (a killed thread)
+ * Inputs: pid - process that isn't running
+ * Return Value: n/a
+ * Effects: drops it from the run queues, a wait queue won't wake it
+ */
+void sched_remove(int32_t pid) {
+    uint32_t flags, cpu, i, j;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    sleeping[pid] = 0;
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        for (i = 0, j = 0; i < rq_count[cpu]; i++) {
+            if (run_queue[cpu][i] != pid)
+                run_queue[cpu][j++] = run_queue[cpu][i];
+        }
+        rq_count[cpu] = j;
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* sched_min
+ * Inputs: cpu - whose run queue to look at
+ * Return Value: run queue index of the process to run first (see sched_order),
+ *               the oldest on a tie, -1 if the running CPU can't run any of them
+ * Call with sched_lock held
+ * A process whose address space another CPU is using has to wait for it
+ * (see sched_mm_busy).
+ */
+static int32_t sched_min(uint32_t cpu) {
+    uint32_t i;
+    int32_t min = -1;
+
+    for (i = 0; i < rq_count[cpu]; i++) {
+        if (sched_mm_busy(PCB_ADDR(run_queue[cpu][i])->mm_pid))
+            continue;
+        if (min < 0 || sched_order(run_queue[cpu][i], run_queue[cpu][min]) < 0)
+            min = i;
+    }
+    return min;
+}
+
+/* sched_order
+ * Inputs: a, b - processes
+ * Return Value: negative if a runs before b, positive if after, 0 for a tie
+ * A real-time process runs before every fair one and before those of a
+ * lower priority; real-time processes of the same priority tie, fair ones
+ * go by vruntime. While the running CPU is throttled every process is
+ * fair (see sched_rt).
+ * Call with sched_lock held
+ */
+static int32_t sched_order(int32_t a, int32_t b) {
+    uint32_t prio_a = sched_rt(a);
+    uint32_t prio_b = sched_rt(b);
+
+    if (prio_a != prio_b)
+        return (int32_t)prio_b - (int32_t)prio_a;
+    if (prio_a != 0)
+        return 0;
+    return (int32_t)(tasks[a].vruntime - tasks[b].vruntime);
+}
+
+/* sched_rt
+ * Inputs: pid - process
+ * Return Value: real-time priority it runs at on the running CPU, 0 in the
+ *               fair class or while the CPU is throttled
+ * Real-time processes get SCHED_RT_RUNTIME ticks of every SCHED_RT_PERIOD
+ * (see sched_charge), so one that never sleeps can't starve the fair class.
+ * Their vruntime keeps growing while they run, so a throttled one queues
+ * behind the fair processes it kept waiting.
+ * Call with sched_lock held
+ */
+static uint32_t sched_rt(int32_t pid) {
+    if (rt_throttled[this_cpu()->id])
+        return 0;
+    return tasks[pid].rt_prio;
+}
+
+/* sched_mm_busy
+ * Inputs: mm - pid owning an address space
+ * Return Value: 1 if another CPU is running a process or thread in it, 0 otherwise
+ * The threads of a process run on one CPU at a time, so its page tables
+ * only ever change under the CPU using them and no other CPU's TLB
+ * needs flushing.
+ */
+int32_t sched_mm_busy(int32_t mm) {
+    uint32_t cpu;
+
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        if (cpu != this_cpu()->id && cpus[cpu].pid >= 0 && PCB_ADDR(cpus[cpu].pid)->mm_pid == mm)
+            return 1;
+    }
+    return 0;
+}
+
+/* sched_tick_others
+ * Passes a PIT tick on to the other CPUs
+ * Inputs: n/a
+ * Return Value: n/a
+ * Effects: sends a reschedule IPI to every CPU with a process to preempt
+ * Only the boot CPU gets PIT interrupts, which drive the scheduler when
+ * the local APIC timers can't.
+ */
+static void sched_tick_others(void) {
+    uint32_t cpu;
+
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        if (cpu != CPU_BSP && cpus[cpu].pid >= 0 && rq_count[cpu] > 0)
+            smp_kick(cpu);
+    }
+}
+
+/* sched_fork
+ * Sets up the fair share state of a new process
+ * Inputs: pid - new process
+ *         parent - process whose nice level it inherits, -1 for none
+ * Return Value: n/a
+ * Effects: starts it level with the least served runnable process, so it
+ *          neither waits behind nor starves the others; it starts in the
+ *          fair class, a program asks for real-time itself (rtprio)
+ */
+void sched_fork(int32_t pid, int32_t parent) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    tasks[pid].nice = (parent >= 0) ? tasks[parent].nice : 0;
+    tasks[pid].weight = nice_weights[tasks[pid].nice - NICE_MIN];
+    tasks[pid].vruntime = min_vruntime;
+    tasks[pid].runtime = 0;
+    tasks[pid].rt_prio = 0;
+    memset(&tasks[pid].usage, 0, sizeof(rusage));
+    tasks[pid].user_kcycles = 0;
+    tasks[pid].kernel_kcycles = 0;
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* sched_charge
+ * Charges the running process for the CPU time since the last charge
+ * Inputs: n/a
+ * Return Value: n/a
+ * Effects: vruntime grows slower the higher the weight, min_vruntime
+ *          follows the least served runnable process; throttles the CPU's
+ *          real-time class once it used up its budget for the period
+ * Called on every scheduler tick and before every switch. Time spent idle
+ * or launching a shell isn't charged to anyone. Each CPU keeps its own
+ * TSC reference and real-time budget, min_vruntime follows the queues of
+ * all of them.
+ */
+void sched_charge(void) {
+    uint32_t flags, now, delta, min, cpu, i, per_tick;
+    int32_t pid = cur_pid;
+    int32_t found = 0;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    sched_acct(ACCT_KERNEL);
+    cpu = this_cpu()->id;
+    now = rdtsc_kcycles();
+    delta = now - last_charge[cpu];
+    last_charge[cpu] = now;
+    if (idling[cpu])
+        idle_time[cpu] += delta;
+    else
+        busy_time[cpu] += delta;
+
+    // no budget before timer_init, when ticks can't be measured
+    per_tick = timer_tick_kcycles();
+    if (now - rt_period[cpu] >= SCHED_RT_PERIOD * per_tick) {
+        rt_period[cpu] = now;
+        rt_used[cpu] = 0;
+    }
+    if (!idling[cpu] && pid >= 0 && pid_status[pid] == 1 && tasks[pid].rt_prio != 0)
+        rt_used[cpu] += delta;
+    rt_throttled[cpu] = per_tick != 0 && rt_used[cpu] >= SCHED_RT_RUNTIME * per_tick;
+
+    min = 0;
+    if (pid >= 0 && pid_status[pid] == 1) {
+        tasks[pid].runtime += delta;
+        tasks[pid].vruntime += delta * nice_weights[NICE_0 - NICE_MIN] / tasks[pid].weight;
+        min = tasks[pid].vruntime;
+        found = 1;
+    }
+
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        for (i = 0; i < rq_count[cpu]; i++) {
+            if (!found || (int32_t)(tasks[run_queue[cpu][i]].vruntime - min) < 0)
+                min = tasks[run_queue[cpu][i]].vruntime;
+            found = 1;
+        }
+    }
+    if (found && (int32_t)(min - min_vruntime) > 0)
+        min_vruntime = min;
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* nice
+ * Changes the priority of the calling process
+ * Inputs: inc - amount to add to the nice level, lower is more CPU
+ * Return Value: 0 on success, -1 if there is no calling process
+ * Effects: the level is clamped to [-20, 19]; processes it executes
+ *          inherit it
+ */
+int32_t nice(int32_t inc) {
+    uint32_t flags;
+    int32_t level;
+
+    if (cur_pid < 0)
+        return -1;
+    if (inc < NICE_MIN - NICE_MAX)
+        inc = NICE_MIN - NICE_MAX;  // keep the sum from overflowing
+    if (inc > NICE_MAX - NICE_MIN)
+        inc = NICE_MAX - NICE_MIN;
+    level = tasks[cur_pid].nice + inc;
+    if (level < NICE_MIN)
+        level = NICE_MIN;
+    if (level > NICE_MAX)
+        level = NICE_MAX;
+
+    sched_charge();     // time so far is charged at the old weight
+    spin_lock_irqsave(&sched_lock, flags);
+    tasks[cur_pid].nice = level;
+    tasks[cur_pid].weight = nice_weights[level - NICE_MIN];
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return 0;
+}
+
+/* rtprio
+ * Moves the calling process to the real-time class or back
+ * Inputs: prio - 1 (lowest) to RT_PRIO_MAX for real-time, 0 for the fair class
+ * Return Value: 0 on success, -1 for a bad priority or no calling process
+ * Effects: a real-time process runs before every fair one and preempts it
+ *          as soon as it wakes (see sched_preempt); only one of a higher
+ *          priority takes the CPU from it, until real-time processes used
+ *          SCHED_RT_RUNTIME ticks of the CPU's SCHED_RT_PERIOD and fair ones
+ *          get the rest (see sched_rt)
+ */
+int32_t rtprio(int32_t prio) {
+    uint32_t flags;
+
+    if (cur_pid < 0 || prio < 0 || prio > RT_PRIO_MAX)
+        return -1;
+    spin_lock_irqsave(&sched_lock, flags);
+    tasks[cur_pid].rt_prio = prio;
+    spin_unlock_irqrestore(&sched_lock, flags);
+    sched_timer();      // lowering it may let a queued process in
+    return 0;
+}
+
+/* sched_acct
+ * Charges the time since this CPU's last sched_acct to the running process
+ * Inputs: mode - ACCT_USER if it was spent in user space, ACCT_KERNEL if in
+ *                the kernel
+ * Return Value: n/a
+ * Effects: whole ticks go to utime or stime, the rest carries over
+ * Called on every entry from and return to user space (see kernel_enter)
+ * and from sched_charge, so time is split at every switch. The idle task
+ * and launch stacks run without a process and aren't charged. Only the
+ * CPU running a process touches its counters.
+ * Call with interrupts disabled.
+ */
+void sched_acct(uint32_t mode) {
+    uint32_t cpu = this_cpu()->id;
+    uint32_t now = rdtsc_kcycles();
+    uint32_t per_tick = timer_tick_kcycles();
+    uint32_t delta = now - last_acct[cpu];
+    int32_t pid = cur_pid;
+    sched_task* task;
+
+    last_acct[cpu] = now;
+    if (pid < 0 || per_tick == 0)
+        return;
+    task = &tasks[pid];
+    if (mode == ACCT_USER) {
+        task->user_kcycles += delta;
+        task->usage.utime += task->user_kcycles / per_tick;
+        task->user_kcycles %= per_tick;
+    }
+    else {
+        task->kernel_kcycles += delta;
+        task->usage.stime += task->kernel_kcycles / per_tick;
+        task->kernel_kcycles %= per_tick;
+    }
+}
+
+/* sched_usage
+ * Inputs: pid - process
+ * Return Value: its counters, for the code that counts system calls and faults
+ */
+rusage* sched_usage(int32_t pid) {
+    return &tasks[pid].usage;
+}
+
+/* getrusage
+ * Reports how much CPU a process used
+ * Inputs: pid - process, -1 for the caller
+ *         usage - user buffer that gets its counters, nice level, real-time
+ *                 priority, terminal, resident size and program name
+ * Return Value: 0 on success, -1 for a bad buffer or a pid not in use
+ * Effects: any process can be looked at, so top can list them all by pid
+ */
+int32_t getrusage(int32_t pid, rusage* usage) {
+    PCB* pcb;
+
+    if (pid == -1)
+        pid = cur_pid;
+    if (pid < 0 || pid >= MAX_PROCESSES || pid_status[pid] != 1)
+        return -1;
+    if ((uint32_t)usage < IMAGE_START || (uint32_t)(usage + 1) > KERNEL_BASE)
+        return -1;
+
+    pcb = PCB_ADDR(pid);
+    *usage = tasks[pid].usage;
+    usage->nice = tasks[pid].nice;
+    usage->rt_prio = tasks[pid].rt_prio;
+    usage->terminal = pcb->tid;
+    usage->resident = paging_resident(pcb->mm_pid);
+    memcpy(usage->name, pcb->name, PCB_NAME_SIZE);
+    usage->name[PCB_NAME_SIZE - 1] = '\0';
+    return 0;
+}
+
+/* sched_preempt
+ * Runs the scheduler if a woken real-time process outranks the running one
+ * Inputs: n/a
+ * Return Value: n/a
+ * Effects: the process gets the CPU now instead of at the end of the slice
+ * Called at the end of interrupts that wake processes, with interrupts
+ * disabled. The PIT and IPIs call scheduler anyway.
+ */
+void sched_preempt(void) {
+    uint32_t cpu = this_cpu()->id;
+    int32_t i, preempt = 0;
+
+    spin_lock(&sched_lock);
+    if (cur_pid >= 0 && pid_status[cur_pid] == 1 && (i = sched_min(cpu)) >= 0)
+        preempt = sched_rt(run_queue[cpu][i]) > sched_rt(cur_pid);
+    spin_unlock(&sched_lock);
+    if (preempt)
+        scheduler();
+}
+
+/* sched_task_stats
+ * Prints how much CPU a process got
+ * Inputs: pid - process
+ * Return Value: n/a
+ * Effects: runtime is in SCHED_UNIT cycles, vruntime in the same unit
+ *          scaled by weight; user and kernel time in ticks (see getrusage)
+ */
+void sched_task_stats(int32_t pid) {
+    rusage* u = &tasks[pid].usage;
+
+    printf("pid %d: nice %d, rt %d, runtime %d, vruntime %d (min %d)\n", pid,
+        tasks[pid].nice, tasks[pid].rt_prio, tasks[pid].runtime, tasks[pid].vruntime, min_vruntime);
+    printf("  %d user + %d kernel ticks, %d + %d switches, %d system calls, %d faults\n",
+        u->utime, u->stime, u->nvcsw, u->nivcsw, u->syscalls, u->faults);
+}
+
+/* sched_sleep
+ * Puts the running process to sleep until the queue is woken
+ * Inputs: wq - wait queue
+ * Return Value: n/a
+ * Effects: runs other processes meanwhile, or the idle task if there are none
+ * Call with interrupts disabled, right after finding the condition false,
+ * so the wakeup can't slip in between, and without a spinlock held. A
+ * caller that checked its condition under a spinlock lets go of it just
+ * before; the kernel lock keeps the waker out until the sleep is recorded.
+ * Without a process (kernel tests) it just waits for the next wakeup.
+ */
+void sched_sleep(wait_queue* wq) {
+    uint32_t wakeups = wq->wakeups;
+    int32_t pid = cur_pid;
+    int32_t next;
+
+    if (pid < 0) {
+        while (wq->wakeups == wakeups) {
+            kernel_unlock();
+            kernel_halt();
+            kernel_lock();
         }
+        return;
+    }
+
+    spin_lock(&sched_lock);
+    wq->waiting |= (1 << pid);
+    sleeping[pid] = 1;
+    spin_unlock(&sched_lock);
+    while (sleeping[pid]) {
+        tasks[pid].usage.nvcsw++;
+        if ((next = sched_dequeue()) != -1)
+            sched_switch(next, &PCB_ADDR(pid)->ctx_esp);
+        else
+            sched_idle(&PCB_ADDR(pid)->ctx_esp);
     }
+}
 
-    // prevent interrupts during context switch(?)
-    cli();  // int flag restored before esp/ebp pointer change in restore_stack
+/* sched_wake
+ * Wakes every process sleeping on a wait queue
+ * Inputs: wq - wait queue
+ * Return Value: n/a
+ * Effects: puts the sleepers back on the run queue, slightly ahead of the
+ *          least served process so an interactive one is picked next
+ * Called from interrupt handlers
+ */
+void sched_wake(wait_queue* wq) {
+    uint32_t flags;
+    int32_t pid;
 
-    /* save old pcb stack */
-    save_stack(cur_pid);
+    spin_lock_irqsave(&sched_lock, flags);
+    wq->wakeups++;
+    for (pid = 0; pid < MAX_PROCESSES; pid++) {
+        // a bit can outlive its sleeper when a thread is killed asleep
+        if (!(wq->waiting & (1 << pid)) || !sleeping[pid])
+            continue;
+        sleeping[pid] = 0;
+        // a sleeper keeps a small head start, not all the time it slept
+        if ((int32_t)(tasks[pid].vruntime - (min_vruntime - SCHED_WAKE_BONUS)) < 0)
+            tasks[pid].vruntime = min_vruntime - SCHED_WAKE_BONUS;
+        rq_add(pid);
+    }
+    wq->waiting = 0;
+    spin_unlock(&sched_lock);
+    sched_timer();
+    restore_flags(flags);
+}
 
-    /* switch terminal/proccess */
-    cur_terminal = next_tid;
-    cur_pid = terminals[cur_terminal].pid;
-    
+/* sched_switch
+ * Switches the CPU to another process
+ * Inputs: next - process to run
+ *         save_esp - where to save the kernel esp of the running context
+ * Return Value: n/a
+ * Effects: returns once the saved context is switched back to
+ */
+static void sched_switch(int32_t next, uint32_t* save_esp) {
+    PCB* pcb = PCB_ADDR(next);
+    cpu_t* cpu;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    sched_charge();
+    cpu = this_cpu();
+    idling[cpu->id] = 0;
+    cur_pid = next;
+    cur_terminal = pcb->tid;
+    paging_syscall(pcb->mm_pid);    // set up process paging, shared by its threads
     video_paging();             // set up video memory paging
-    paging_syscall(cur_pid);    // set up process paging
-    
-    /* context switch, restore stack */
-    restore_stack(cur_pid); 
+
+    cpu->tss->ss0 = KERNEL_DS;              // set ss0 to kernel's stack segment
+    if (apic_timer_ready())
+        apic_timer_oneshot(0);              // the new slice starts now
+    else if (cpu->id == CPU_BSP)
+        pit_oneshot(0);
+    sched_timer();
+    // esp0 goes to the bottom of the process's kernel stack
+    context_switch(save_esp, pcb->ctx_esp, KERNEL_STACKS - KB_8*next - 4);
+    restore_flags(flags);
+}
+
+/* sched_idle
+ * Switches the CPU to the idle task
+ * Inputs: save_esp - where to save the kernel esp of the running context
+ * Return Value: n/a
+ * Effects: returns once the saved context is switched back to
+ * The idle task keeps the last process's page directory, it only touches
+ * the kernel half. Every CPU has its own.
+ */
+static void sched_idle(uint32_t* save_esp) {
+    uint32_t flags, cpu;
+
+    cli_and_save(flags);
+    cpu = this_cpu()->id;
+    if (idle_esp[cpu] == 0)
+        idle_esp[cpu] = sched_frame(&idle_stack[cpu][IDLE_STACK_SIZE / 4], idle_task);
+    sched_charge();
+    idling[cpu] = 1;
+    cur_pid = -1;   // nothing for the timer to preempt
+    sched_timer();
+    context_switch(save_esp, idle_esp[cpu], 0);
+    restore_flags(flags);
+}
+
+/* idle_task
+ * Runs when no process is runnable
+ * Inputs: n/a
+ * Return Value: n/a
+ * Effects: zeroes frames for the pre-zeroed pool, then halts until an
+ *          interrupt makes a process runnable
+ * The only place a CPU lets go of the kernel lock without leaving the
+ * kernel. Other CPUs can only queue work while it is let go, and the IPI
+ * they send then wakes the halt.
+ */
+static void idle_task(void) {
+    int32_t next;
+
+    while (1) {
+        cli();
+        if ((next = sched_dequeue()) != -1) {
+            sched_switch(next, &idle_esp[this_cpu()->id]);
+            continue;
+        }
+        sti();
+        frame_zero_refill();
+        cli();
+        if (sched_runnable() == 0) {
+            kernel_unlock();
+            kernel_halt();
+            kernel_lock();
+        }
+    }
+}
+
+/* sched_runnable
+ * Inputs: n/a
+ * Return Value: number of processes on the running CPU's run queue
+ */
+uint32_t sched_runnable(void) {
+    return rq_count[this_cpu()->id];
+}
+
+/* sched_timer
+ * Arms the running CPU's local APIC timer for the end of the running
+ * process's slice, if it has one
+ * Inputs: n/a
+ * Return Value: n/a
+ * Effects: stops the timer when nothing is waiting for the CPU, so a lone
+ *          process or the idle task takes no timer interrupts
+ * Call with interrupts disabled whenever the run queue or the running
+ * process changes. A slice already counting down is left alone.
+ * Without a local APIC timer the shared PIT is armed while any CPU has
+ * a slice, the boot CPU passes its ticks on (see sched_tick_others).
+ * The PIT also keeps ticking while a kernel timer is pending, at the
+ * shorter TIMER_TICK_COUNT (see timer_arm).
+ */
+void sched_timer(void) {
+    uint32_t cpu = this_cpu()->id;
+
+    if (apic_timer_ready()) {
+        if (cur_pid >= 0 && rq_count[cpu] > 0) {
+            if (!apic_timer_armed())
+                apic_timer_oneshot(SCHED_SLICE_US);
+        }
+        else if (apic_timer_armed()) {
+            apic_timer_oneshot(0);
+        }
+        return;
+    }
+
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        if (cpus[cpu].online && cpus[cpu].pid >= 0 && rq_count[cpu] > 0)
+            break;
+    }
+    if (timer_waiting()) {
+        timer_arm();
+    }
+    else if (cpu < num_cpus) {
+        if (!pit_armed())
+            pit_oneshot(SLICE_COUNT);
+    }
+    else if (pit_armed()) {
+        pit_oneshot(0);
+    }
+}
+
+/* sched_idle_stats
+ * Prints CPU utilization since boot
+ * Inputs: n/a
+ * Return Value: n/a
+ * Effects: a line per CPU, nothing for a CPU before its first charge
+ */
+void sched_idle_stats(void) {
+    uint32_t cpu, total;
+
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        total = busy_time[cpu] + idle_time[cpu];
+        if (total < 100)
+            continue;
+        printf("cpu %d: %d of %d kcycles idle (%d%% utilization), %d timer interrupts\n",
+            cpu, idle_time[cpu], total, busy_time[cpu] / (total / 100), cpus[cpu].timer_interrupts);
+    }
+    printf("%d PIT interrupts\n", pit_interrupts());
+}
+
+/* sched_frame
+ * Builds the frame context_switch expects on a fresh kernel stack
+ * Inputs: top - first address past the stack
+ *         entry - function the context starts in, must never return
+ * Return Value: esp to pass to context_switch
+ * Effects: the context starts with interrupts disabled
+ */
+static uint32_t sched_frame(uint32_t* top, void (*entry)(void)) {
+    uint32_t* esp = top;
+
+    // frame popped by context_switch: eflags, edi, esi, ebx, ebp, return address
+    *--esp = 0;                         // return address of entry, never used
+    *--esp = (uint32_t)entry;
+    *--esp = 0;
+    *--esp = 0;
+    *--esp = 0;
+    *--esp = 0;
+    *--esp = EFLAGS_RESERVED;           // IF clear
+    return (uint32_t)esp;
 }
 
-/* save_stack
- * Saves esp/ebp of the process to the corresponding PCB
- * Inputs: pid - process to save
+/* bench_partner
+ * Other side of sched_bench, switches straight back every time
+ * Inputs: n/a
  * Return Value: n/a
- * Effects: updates esp/ebp in the PCB struct
  */
-void save_stack(int pid) {
-    uint32_t esp, ebp;
-    PCB* pcb = (PCB*)(MB_8 - KB_8*(pid + 1));
-    // store esp and ebp in the PCB
-    asm volatile("movl %%esp, %0":"=g"(esp));
-    pcb->esp = esp;
-    asm volatile("movl %%ebp, %0":"=g"(ebp));
-    pcb->ebp = ebp;
+static void bench_partner(void) {
+    while (1)
+        context_switch(&bench_esp, bench_main_esp, 0);
 }
 
-/* restore_stack
- * Restores esp/ebp of the process to the corresponding PCB
- * Inputs: pid - process to restore
+/* sched_bench
+ * Measures the cost of a context switch
+ * Inputs: rounds - round trips to time
+ * Return Value: average TSC cycles per context_switch
+ * Effects: bounces between this stack and a private one, so no process
+ *          is needed; paging and the TSS are left alone, sched_switch
+ *          adds a CR3 reload on top
+ */
+uint32_t sched_bench(uint32_t rounds) {
+    uint32_t flags, i, start, cycles;
+
+    if (rounds == 0)
+        return 0;
+    cli_and_save(flags);
+    bench_esp = sched_frame(&bench_stack[BENCH_STACK_SIZE / 4], bench_partner);
+    start = rdtsc();
+    for (i = 0; i < rounds; i++)
+        context_switch(&bench_main_esp, bench_esp, 0);
+    cycles = rdtsc() - start;
+    restore_flags(flags);
+
+    return cycles / (2 * rounds);
+}
+
+/* sched_launch
+ * Executes the first shell of cur_terminal on a stack of its own
+ * Inputs: n/a
  * Return Value: n/a
- * Effects: changes the tss pointers and esp/ebp to those stored
- *          in the PCB specified by the input pid
+ * Effects: the running process (if any) goes on the run queue and resumes
+ *          here when it is next scheduled
+ * Called with interrupts disabled, from the keyboard interrupt of
+ * whatever process happened to be running, or from halt of a terminal's
+ * last process, which is gone by then and never resumes.
  */
-void restore_stack(int pid) {
-    uint32_t esp, ebp;
-    PCB* pcb = (PCB*)(MB_8 - KB_8*(pid + 1));
-    // change tss pointers
-    tss.ss0 = KERNEL_DS;                // set ss0 to kernel's stack segment
-    tss.esp0 = MB_8 - (KB_8*pid) - 4;   // set esp0 to bottom of process's kernel stack
-    // restore esp and ebp from PCB
-    esp = pcb->esp;
-    ebp = pcb->ebp;
-    sti();
-    asm volatile("movl %0, %%esp":"=g"(esp));
-    asm volatile("movl %0, %%ebp":"=g"(ebp));
+void sched_launch(void) {
+    uint32_t esp = sched_frame(&launch_stacks[cur_terminal][LAUNCH_STACK_SIZE / 4], launch_shell);
+    uint32_t* save_esp = &discarded_esp;
+    uint32_t cpu = this_cpu()->id;
+
+    if (cur_pid >= 0 && pid_status[cur_pid] == 1) {
+        sched_enqueue(cur_pid);
+        save_esp = &PCB_ADDR(cur_pid)->ctx_esp;
+        tasks[cur_pid].usage.nivcsw++;
+    }
+    else if (idling[cpu]) {
+        save_esp = &idle_esp[cpu];
+    }
+    sched_charge();
+    idling[cpu] = 0;
+    cur_pid = -1;   // no preemption until execute has a process to run
+    context_switch(save_esp, esp, 0);
 }
 
+/* launch_shell
+ * Bottom of a launch stack
+ * Inputs: n/a
+ * Return Value: n/a
+ * Effects: execute only comes back if the shell couldn't be started, then
+ *          the CPU goes to the next runnable process or the idle task
+ */
+static void launch_shell(void) {
+    execute((uint8_t*)"shell");
+    sched_exit();
+}
+
+/* sched_start
+ * Makes a loaded process runnable without switching to it
+ * Inputs: pid - process whose kernel stack is unused
+ *         entry - function it starts in on its kernel stack, must never return
+ * Return Value: n/a
+ */
+void sched_start(int32_t pid, void (*entry)(void)) {
+    PCB_ADDR(pid)->ctx_esp = sched_frame((uint32_t*)(KERNEL_STACKS - KB_8*pid - 4), entry);
+    sched_enqueue(pid);
+}
+
+/* sched_exit
+ * Gives up the CPU for good
+ * Inputs: n/a
+ * Return Value: never returns
+ * Effects: runs the next runnable process or the idle task, the current
+ *          context (a halted process or a launch stack) is abandoned
+ */
+void sched_exit(void) {
+    int32_t next;
 
+    cli();
+    if ((next = sched_dequeue()) != -1)
+        sched_switch(next, &discarded_esp);
+    else
+        sched_idle(&discarded_esp);
+}
@@ -5,10 +5,106 @@
 #ifndef _SCHEDULING_H
 #define _SCHEDULING_H
 
+#include "types.h"
+#include "pcb.h"
+
+/* processes sleeping on an event, woken all at once */
+typedef struct wait_queue_t {
+    volatile uint32_t waiting;      // bit per sleeping pid
+    volatile uint32_t wakeups;      // times the queue was woken
+} wait_queue;
+
+/* CPU usage of a process, for getrusage */
+typedef struct rusage_t {
+    uint32_t utime;                 // TIMER_TICK_MS ticks spent in user space
+    uint32_t stime;                 // ticks spent in the kernel on its behalf
+    uint32_t nvcsw;                 // times it gave up the CPU to wait
+    uint32_t nivcsw;                // times it was preempted
+    uint32_t syscalls;              // system calls made
+    uint32_t faults;                // page faults taken, demand paging included
+    int32_t nice;                   // filled in by getrusage
+    uint32_t rt_prio;
+    uint32_t terminal;
+    uint32_t resident;              // KB of memory mapped (see paging_resident)
+    uint8_t name[PCB_NAME_SIZE];    // program it runs (its process's, for a thread)
+} rusage;
+
+/* fair share state of a process */
+typedef struct sched_task_t {
+    int32_t nice;                   // priority, NICE_MIN (most CPU) to NICE_MAX
+    uint32_t weight;                // share of the CPU, from the nice level
+    uint32_t vruntime;              // runtime scaled by NICE_0's weight / weight, lowest runs next
+    uint32_t runtime;               // CPU time received, in SCHED_UNIT cycles
+    uint32_t rt_prio;               // real-time priority, 0 for the fair class
+    rusage usage;                   // counters for getrusage
+    uint32_t user_kcycles;          // rdtsc_kcycles in user space not making up a tick of utime yet
+    uint32_t kernel_kcycles;        // the same for stime
+} sched_task;
+
+#define NICE_MIN            -20
+#define NICE_MAX            19
+#define NICE_0              0
+#define RT_PRIO_MAX         31      // real-time priorities are 1 (lowest) to RT_PRIO_MAX
+#define SCHED_UNIT          1024    // TSC cycles per unit of runtime (see rdtsc_kcycles)
+#define SCHED_WAKE_BONUS    20000   // vruntime a woken sleeper may be ahead of the others (about a tick at 1 GHz)
+#define SCHED_SLICE_US      20000   // slice on the local APIC timer, as long as the PIT's SLICE_COUNT
+#define SCHED_RT_PERIOD     100     // timer ticks in each real-time budget period (1 s)
+#define SCHED_RT_RUNTIME    95      // ticks of it real-time processes may use, the rest is left to fair ones
+
+#define LAUNCH_STACK_SIZE   8192    // stack a new terminal's first shell is executed on (like a kernel stack)
+#define IDLE_STACK_SIZE     4096    // stack of the idle task
+#define BENCH_STACK_SIZE    1024    // stack sched_bench switches to
+#define EFLAGS_RESERVED     0x2     // bit 1 of EFLAGS is always set
+#define EFLAGS_IF           0x200   // interrupts enabled
+#define ACCT_KERNEL         0       // sched_acct: the time was spent in the kernel
+#define ACCT_USER           1       // in user space
+
 void scheduler();
 
-// context switch helper functions
-void save_stack(int pid);
-void restore_stack(int pid);
+/* fair share accounting */
+void sched_fork(int32_t pid, int32_t parent);
+void sched_charge(void);
+void sched_task_stats(int32_t pid);
+
+/* CPU accounting - user and kernel time, switches, system calls and faults */
+void sched_acct(uint32_t mode);
+rusage* sched_usage(int32_t pid);
+
+/* system call 23 */
+int32_t getrusage(int32_t pid, rusage* usage);
+
+/* system call 15 */
+int32_t nice(int32_t inc);
+
+/* system call 22 - real-time class, fixed priority above every fair process */
+int32_t rtprio(int32_t prio);
+void sched_preempt(void);
+
+/* run queues - per CPU, runnable processes other than the running ones */
+void sched_enqueue(int32_t pid);
+int32_t sched_dequeue(void);
+void sched_remove(int32_t pid);
+uint32_t sched_runnable(void);
+int32_t sched_mm_busy(int32_t mm);
+
+/* sleeping - call with interrupts disabled, right after checking the condition */
+void sched_sleep(wait_queue* wq);
+void sched_wake(wait_queue* wq);
+
+/* executes the first shell of cur_terminal, the running process stays runnable */
+void sched_launch(void);
+
+/* runs a loaded process later from entry, and leaves the CPU for good */
+void sched_start(int32_t pid, void (*entry)(void));
+void sched_exit(void);
+
+/* arms the timer for the next slice, or stops it when there is nothing to preempt */
+void sched_timer(void);
+
+/* average TSC cycles per context switch over rounds round trips */
+uint32_t sched_bench(uint32_t rounds);
+
+/* prints the share of time the idle task didn't get */
+void sched_idle_stats(void);
 
 #endif
@@ -0,0 +1,213 @@
+/* shm.c - Functionality for named shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#include "shm.h"
+#include "lib.h"
+#include "cr.h"
+#include "frames.h"
+
+static shm_segment shm_segments[SHM_SEGMENTS];
+static shm_segment* shm_attached[MAX_PROCESSES][SHM_SLOTS];  // segment in each 1 MB slot, NULL if free
+
+static int32_t shm_map(int32_t pid, shm_segment* seg);
+static void shm_unmap(int32_t pid, uint32_t slot);
+static shm_segment* shm_find(const int8_t* name);
+static int32_t shm_name(int8_t* buf, const uint8_t* name);
+
+/* shm_create
+ * Creates a named segment and attaches it to the current process
+ * Inputs: name - segment name (shorter than SHM_NAME_LEN)
+ *         size - size in bytes, rounded up to whole pages
+ * Outputs: address of the segment on success, -1 on failure
+ * Effects: allocates and zeroes the frames of the segment
+ * The segment is destroyed when the last process detaches from it
+ */
+int32_t shm_create(const uint8_t* name, uint32_t size) {
+	PCB *pcb = MM_PCB(cur_pid);
+	int8_t buf[SHM_NAME_LEN];
+	shm_segment* seg;
+	uint32_t i;
+	int32_t addr;
+
+	if (shm_name(buf, name) == -1 || buf[0] == '\0')
+		return -1;
+	if (size == 0 || size > SHM_MAX_PAGES * KB_4 || shm_find(buf) != NULL)
+		return -1;
+
+	for (seg = shm_segments; seg < shm_segments + SHM_SEGMENTS; seg++) {
+		if (seg->users == 0)
+			break;
+	}
+	if (seg == shm_segments + SHM_SEGMENTS)
+		return -1;
+
+	// the segment holds one reference to each frame, every mapping adds one
+	seg->count = (size + KB_4 - 1) / KB_4;
+	for (i = 0; i < seg->count; i++) {
+		if ((seg->frames[i] = page_alloc_zeroed()) == 0) {
+			while (i-- > 0)
+				frame_free(seg->frames[i]);
+			return -1;
+		}
+	}
+	strcpy(seg->name, buf);
+
+	if ((addr = shm_map(pcb->pid, seg)) == -1) {
+		for (i = 0; i < seg->count; i++)
+			frame_free(seg->frames[i]);
+		return -1;
+	}
+	return addr;
+}
+
+/* shm_attach
+ * Attaches an existing segment to the current process
+ * Inputs: name - segment name
+ * Outputs: address of the segment on success, -1 on failure
+ * Effects: maps the frames of the segment, flushes TLB
+ */
+int32_t shm_attach(const uint8_t* name) {
+	PCB *pcb = MM_PCB(cur_pid);
+	int8_t buf[SHM_NAME_LEN];
+	shm_segment* seg;
+
+	if (shm_name(buf, name) == -1 || (seg = shm_find(buf)) == NULL)
+		return -1;
+	return shm_map(pcb->pid, seg);
+}
+
+/* shm_detach
+ * Detaches a segment from the current process
+ * Inputs: addr - address returned by shm_create or shm_attach
+ * Outputs: 0 on success, -1 on failure
+ * Effects: unmaps the segment, flushes TLB
+ */
+int32_t shm_detach(void* addr) {
+	PCB *pcb = MM_PCB(cur_pid);
+	uint32_t slot;
+
+	if ((uint32_t)addr < SHM_START || (uint32_t)addr >= SHM_START + SHM_SLOTS * SHM_MAX_PAGES * KB_4)
+		return -1;
+	slot = ((uint32_t)addr - SHM_START) / (SHM_MAX_PAGES * KB_4);
+	if (shm_attached[pcb->pid][slot] == NULL)
+		return -1;
+
+	shm_unmap(pcb->pid, slot);
+	return 0;
+}
+
+/* shm_detach_all
+ * Detaches every segment of a process
+ * Inputs: pid - process id
+ * Outputs: none
+ * Effects: may destroy segments, flushes TLB
+ */
+void shm_detach_all(int32_t pid) {
+	uint32_t slot;
+
+	for (slot = 0; slot < SHM_SLOTS; slot++) {
+		if (shm_attached[pid][slot] != NULL)
+			shm_unmap(pid, slot);
+	}
+}
+
+/* shm_map
+ * Maps a segment into the first free slot of a process's window
+ * Inputs: pid - process id
+ *         seg - segment to map
+ * Outputs: address of the slot, -1 if every slot is taken or there is
+ *          no memory for the page table
+ * Effects: flushes TLB
+ */
+static int32_t shm_map(int32_t pid, shm_segment* seg) {
+	uint32_t slot, i, addr;
+	uint32_t* pte;
+
+	for (slot = 0; slot < SHM_SLOTS; slot++) {
+		if (shm_attached[pid][slot] == NULL)
+			break;
+	}
+	if (slot == SHM_SLOTS)
+		return -1;
+
+	// a 1 MB slot never straddles two page tables
+	addr = SHM_START + slot * SHM_MAX_PAGES * KB_4;
+	if ((pte = paging_pte(pid, addr, 1)) == NULL)
+		return -1;
+	for (i = 0; i < seg->count; i++) {
+		frame_ref(seg->frames[i]);
+		pte[i] = seg->frames[i];
+		pte[i] |= PAGE_P;
+		pte[i] |= PAGE_RW;
+		pte[i] |= PAGE_US;
+		pte[i] |= PAGE_PINNED;	// never swapped out
+	}
+	shm_attached[pid][slot] = seg;
+	seg->users++;
+	flush_TLB();
+
+	return addr;
+}
+
+/* shm_unmap
+ * Unmaps a slot of a process's window
+ * Inputs: pid - process id
+ *         slot - attached slot
+ * Outputs: none
+ * Effects: destroys the segment when this was the last attachment, flushes TLB
+ */
+static void shm_unmap(int32_t pid, uint32_t slot) {
+	shm_segment* seg = shm_attached[pid][slot];
+	uint32_t* pte = paging_pte(pid, SHM_START + slot * SHM_MAX_PAGES * KB_4, 0);
+	uint32_t i;
+
+	for (i = 0; i < seg->count; i++) {
+		frame_free(pte[i] & PAGE_MASK);
+		pte[i] = 0;
+	}
+	shm_attached[pid][slot] = NULL;
+
+	if (--seg->users == 0) {
+		for (i = 0; i < seg->count; i++)
+			frame_free(seg->frames[i]);
+		seg->name[0] = '\0';
+	}
+	flush_TLB();
+}
+
+/* shm_find
+ * Looks up a live segment by name
+ * Inputs: name - segment name, in kernel memory (see shm_name)
+ * Outputs: the segment, NULL if there is none
+ */
+static shm_segment* shm_find(const int8_t* name) {
+	shm_segment* seg;
+
+	for (seg = shm_segments; seg < shm_segments + SHM_SEGMENTS; seg++) {
+		if (seg->users && strncmp(seg->name, name, SHM_NAME_LEN) == 0)
+			return seg;
+	}
+	return NULL;
+}
+
+/* shm_name
+ * Copies a segment name in from user space
+ * Inputs: buf - SHM_NAME_LEN bytes of kernel memory
+ *         name - user pointer
+ * Outputs: 0 on success, -1 if name isn't in user space or has no
+ *          terminator within SHM_NAME_LEN bytes
+ * Never reads more than SHM_NAME_LEN bytes or past the end of user space.
+ */
+static int32_t shm_name(int8_t* buf, const uint8_t* name) {
+	uint32_t i;
+
+	if ((uint32_t)name < IMAGE_START || (uint32_t)name >= KERNEL_BASE)
+		return -1;
+	for (i = 0; i < SHM_NAME_LEN && (uint32_t)(name + i) < KERNEL_BASE; i++) {
+		buf[i] = name[i];
+		if (buf[i] == '\0')
+			return 0;
+	}
+	return -1;
+}
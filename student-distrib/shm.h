@@ -0,0 +1,33 @@
+/* shm.h - Defines for named shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+#include "paging.h"
+#include "systemcall.h"
+
+#define SHM_SEGMENTS    8                   // segments that can exist at once
+#define SHM_NAME_LEN    32                  // longest segment name, including the terminator
+#define SHM_MAX_PAGES   256                 // largest segment is 1 MB
+#define SHM_SLOTS       16                  // attachments per process (1 MB each)
+
+// frames of a shared segment, mapped into every process attached to it
+typedef struct shm_segment_t {
+	int8_t name[SHM_NAME_LEN];
+	int32_t users;      // attached processes, 0 if the slot is free
+	uint32_t count;     // number of pages
+	uint32_t frames[SHM_MAX_PAGES];
+} shm_segment;
+
+/* system calls 12-14 */
+int32_t shm_create(const uint8_t* name, uint32_t size);
+int32_t shm_attach(const uint8_t* name);
+int32_t shm_detach(void* addr);
+
+/* detaches every segment of a process (on halt) */
+void shm_detach_all(int32_t pid);
+
+#endif
@@ -0,0 +1,213 @@
+/* signal.c - Functionality for user signals
+ * vim:ts=4 noexpandtab
+ */
+
+#include "signal.h"
+#include "systemcall.h"
+#include "paging.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "scheduling.h"
+
+#define EFLAGS_USER     0x0CD5	// arithmetic flags and DF, all a handler may change
+#define TRAMPOLINE_SIZE 8		// code on the user stack a handler returns to
+
+/* movl $SYS_SIGRETURN, %eax; int $0x80; padded to TRAMPOLINE_SIZE */
+static const uint8_t trampoline[TRAMPOLINE_SIZE] = {0xB8, SYS_SIGRETURN, 0, 0, 0, 0xCD, 0x80, 0x90};
+
+static uint32_t sig_handler[MAX_PROCESSES][NUM_SIGNALS];	// per process, 0 for the default action
+static uint32_t sig_pending[MAX_PROCESSES];	// bit per signal sent to the pid and not delivered yet
+static uint32_t sig_blocked[MAX_PROCESSES];	// 1 while the pid runs a handler, until sigreturn
+static uint32_t alarm_us;					// time since the last SIGALRM
+
+static int32_t signal_frame(hw_context* ctx, int32_t signum, uint32_t handler);
+
+/* set_handler
+ * Sets the function a signal runs in the current process
+ * Inputs: signum - signal number
+ *         handler_address - user function taking the signal number, NULL for the default action
+ * Outputs: 0 on success, -1 on failure
+ * Effects: the default action kills the process for DIV_ZERO, SEGFAULT
+ *          and INTERRUPT and ignores ALARM and USER1
+ */
+int32_t set_handler(int32_t signum, void* handler_address) {
+	uint32_t addr = (uint32_t)handler_address;
+
+	if (signum < 0 || signum >= NUM_SIGNALS)
+		return -1;
+	if (addr != 0 && (addr < PROGRAM_IMAGE_ADDR || addr >= KERNEL_BASE))
+		return -1;
+
+	sig_handler[PCB_ADDR(cur_pid)->mm_pid][signum] = addr;
+	return 0;
+}
+
+/* sigreturn
+ * Returns from a signal handler to where the signal interrupted
+ * Inputs: none
+ * Outputs: EAX of the interrupted context (so it survives the system
+ *          call return), -1 if no handler is running
+ * Effects: restores the registers signal_frame saved on the user stack
+ *          into the context this system call returns to
+ */
+int32_t sigreturn(void) {
+	hw_context* ctx = USER_CONTEXT(cur_pid);
+	hw_context* saved;
+
+	if (!sig_blocked[cur_pid])
+		return -1;
+	// the handler returned to the trampoline, popping the return address
+	saved = (hw_context*)(ctx->esp + 4);
+	if ((uint32_t)saved < PROGRAM_IMAGE_ADDR || (uint32_t)(saved + 1) > KERNEL_BASE)
+		return -1;
+
+	ctx->ebx = saved->ebx;
+	ctx->ecx = saved->ecx;
+	ctx->edx = saved->edx;
+	ctx->esi = saved->esi;
+	ctx->edi = saved->edi;
+	ctx->ebp = saved->ebp;
+	ctx->eip = saved->eip;
+	ctx->esp = saved->esp;
+	// segments stay user segments and interrupts stay on, whatever the handler left
+	ctx->eflags = (saved->eflags & EFLAGS_USER) | EFLAGS_IF;
+	sig_blocked[cur_pid] = 0;
+
+	return saved->eax;
+}
+
+/* signal_check
+ * Delivers pending signals to a process about to return to user space
+ * Inputs: ctx - registers the kernel entry saved, restored by the iret
+ * Outputs: none
+ * Effects: runs the default action, or redirects ctx to the handler on a
+ *          signal frame pushed on the user stack; only one handler runs at a time
+ * Called with interrupts disabled.
+ */
+void signal_check(hw_context* ctx) {
+	int32_t pid = cur_pid;
+	int32_t signum;
+	uint32_t handler;
+
+	if (pid < 0 || pid_status[pid] != 1 || (ctx->cs & 0x3) != (USER_CS & 0x3))
+		return;
+
+	for (signum = 0; signum < NUM_SIGNALS && !sig_blocked[pid]; signum++) {
+		if (!(sig_pending[pid] & (1 << signum)))
+			continue;
+		sig_pending[pid] &= ~(1 << signum);
+
+		handler = sig_handler[PCB_ADDR(pid)->mm_pid][signum];
+		if (handler != 0 && signal_frame(ctx, signum, handler) == 0)
+			return;
+		if (handler != 0 || signum == SIG_DIV_ZERO || signum == SIG_SEGFAULT || signum == SIG_INTERRUPT) {
+			printf("PID %d killed by signal %d\n", pid, signum);
+			halt_extend(SIG_KILL_STATUS);
+		}
+	}
+}
+
+/* signal_frame
+ * Sets up a process's return to user space to run a signal handler
+ * Inputs: ctx - registers saved on kernel entry
+ *         signum - signal number, the handler's argument
+ *         handler - user function
+ * Outputs: 0 on success, -1 if the user stack can't hold the frame
+ * Effects: pushes the trampoline, a copy of ctx, signum and a return
+ *          address to the trampoline on the user stack, and points ctx
+ *          at the handler; the handler finds ctx right above its argument
+ */
+static int32_t signal_frame(hw_context* ctx, int32_t signum, uint32_t handler) {
+	uint32_t esp = ctx->esp;
+	uint32_t code;
+
+	if (esp > KERNEL_BASE || esp < PROGRAM_IMAGE_ADDR + TRAMPOLINE_SIZE + sizeof(hw_context) + 8)
+		return -1;
+
+	esp -= TRAMPOLINE_SIZE;
+	code = esp;
+	memcpy((void*)code, trampoline, TRAMPOLINE_SIZE);
+	esp -= sizeof(hw_context);
+	memcpy((void*)esp, ctx, sizeof(hw_context));
+	esp -= 4;
+	*(uint32_t*)esp = signum;
+	esp -= 4;
+	*(uint32_t*)esp = code;
+
+	ctx->esp = esp;
+	ctx->eip = handler;
+	sig_blocked[cur_pid] = 1;
+	return 0;
+}
+
+/* signal_send
+ * Marks a signal pending for a process or thread
+ * Inputs: pid - receiver
+ *         signum - signal number
+ * Outputs: none
+ * Effects: delivered the next time pid returns to user space
+ */
+void signal_send(int32_t pid, int32_t signum) {
+	if (pid < 0 || pid >= MAX_PROCESSES || signum < 0 || signum >= NUM_SIGNALS)
+		return;
+	if (pid_status[pid] != 1)
+		return;
+	sig_pending[pid] |= (1 << signum);
+}
+
+/* signal_fatal
+ * Checks if a process has a pending signal that will kill it
+ * Inputs: pid - process or thread
+ * Outputs: 1 if so, 0 otherwise
+ * Effects: none, lets blocking reads give up so the signal is delivered
+ */
+int32_t signal_fatal(int32_t pid) {
+	uint32_t* handlers = sig_handler[PCB_ADDR(pid)->mm_pid];
+	uint32_t fatal = 0;
+
+	if (!handlers[SIG_DIV_ZERO])
+		fatal |= (1 << SIG_DIV_ZERO);
+	if (!handlers[SIG_SEGFAULT])
+		fatal |= (1 << SIG_SEGFAULT);
+	if (!handlers[SIG_INTERRUPT])
+		fatal |= (1 << SIG_INTERRUPT);
+	return (sig_pending[pid] & fatal) != 0;
+}
+
+/* signal_reset
+ * Clears the signal state of a new process or thread
+ * Inputs: pid - the new pid
+ * Outputs: none
+ * Effects: a new process gets default actions, a thread shares its process's
+ */
+void signal_reset(int32_t pid) {
+	int32_t i;
+
+	sig_pending[pid] = 0;
+	sig_blocked[pid] = 0;
+	if (PCB_ADDR(pid)->mm_pid == pid) {
+		for (i = 0; i < NUM_SIGNALS; i++)
+			sig_handler[pid][i] = 0;
+	}
+}
+
+/* signal_tick
+ * Sends SIGALRM to every process each SIG_ALARM_US
+ * Inputs: us - microseconds since the last call
+ * Outputs: none
+ * Called from the RTC interrupt
+ */
+void signal_tick(uint32_t us) {
+	int32_t pid;
+
+	alarm_us += us;
+	if (alarm_us < SIG_ALARM_US)
+		return;
+	alarm_us -= SIG_ALARM_US;
+
+	// ignored unless a handler is set, threads share their process's
+	for (pid = 0; pid < MAX_PROCESSES; pid++) {
+		if (pid_status[pid] == 1 && PCB_ADDR(pid)->mm_pid == pid)
+			signal_send(pid, SIG_ALARM);
+	}
+}
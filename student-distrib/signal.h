@@ -0,0 +1,62 @@
+/* signal.h - Defines for user signals
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+#include "types.h"
+
+/* signal numbers, as in ece391syscall.h */
+#define SIG_DIV_ZERO    0
+#define SIG_SEGFAULT    1
+#define SIG_INTERRUPT   2
+#define SIG_ALARM       3
+#define SIG_USER1       4
+#define NUM_SIGNALS     5
+
+#define SIG_KILL_STATUS 256			// halt status of a process killed by a signal, as for an exception
+#define SIG_ALARM_US    10000000	// SIGALRM period (10 s)
+#define SYS_SIGRETURN   10			// system call the signal trampoline makes
+
+#ifndef ASM
+
+/* registers saved on the kernel stack on every entry from an interrupt,
+ * exception or system call (see isr.S), and copied to the user stack
+ * under a signal handler's argument */
+typedef struct hw_context_t {
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	uint32_t esi;
+	uint32_t edi;
+	uint32_t ebp;
+	uint32_t eax;
+	uint32_t ds;
+	uint32_t es;
+	uint32_t fs;
+	uint32_t vector;		// IRQ/exception number
+	uint32_t error_code;	// 0 unless the processor pushed one
+	uint32_t eip;
+	uint32_t cs;
+	uint32_t eflags;
+	uint32_t esp;
+	uint32_t ss;
+} hw_context;
+
+/* context saved when pid entered the kernel from user space, at the top of its kernel stack */
+#define USER_CONTEXT(pid)   ((hw_context*)(KERNEL_STACKS - KB_8*(pid) - 4) - 1)
+
+/* system calls 9-10 are set_handler and sigreturn, see systemcall.h */
+
+/* called on the way back from every interrupt, exception and system call */
+void signal_check(hw_context* ctx);
+
+void signal_send(int32_t pid, int32_t signum);
+int32_t signal_fatal(int32_t pid);
+void signal_reset(int32_t pid);
+void signal_tick(uint32_t us);
+
+#endif
+
+#endif
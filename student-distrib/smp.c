@@ -0,0 +1,333 @@
+/* smp.c - Functionality for multiprocessor support
+ * vim:ts=4 noexpandtab
+ */
+
+#include "smp.h"
+#include "apic.h"
+#include "lib.h"
+#include "paging.h"
+#include "cr.h"
+#include "pit.h"
+#include "scheduling.h"
+#include "lock.h"
+#include "idt.h"
+
+cpu_t cpus[MAX_CPUS];
+uint32_t num_cpus = 1;
+
+static spinlock kernel_spinlock = SPINLOCK_INIT("kernel");	// the big kernel lock
+static cpu_t* ap_booting;						// CPU smp_boot is starting
+static uint32_t ap_stacks[MAX_CPUS][AP_STACK_SIZE / 4];
+
+static mp_float* mp_scan(uint32_t start, uint32_t len);
+static uint8_t mp_checksum(void* table, uint32_t len);
+static void percpu_desc(seg_desc_t* desc, cpu_t* cpu);
+static void tss_desc(seg_desc_t* desc, tss_t* cpu_tss);
+
+/* smp_bsp_init
+ * Sets up the per-CPU state of the boot CPU
+ * Inputs: none
+ * Outputs: none
+ * Effects: points %gs at cpus[CPU_BSP] and takes the kernel lock; the
+ *          other entries get their ids, they start in smp_boot
+ */
+void smp_bsp_init(void) {
+	uint32_t i;
+
+	for (i = 0; i < MAX_CPUS; i++) {
+		cpus[i].self = &cpus[i];
+		cpus[i].tss = &cpus[i].ap_tss;
+		cpus[i].id = i;
+		cpus[i].pid = -1;
+	}
+	cpus[CPU_BSP].tss = &tss;
+	cpus[CPU_BSP].online = 1;
+
+	percpu_desc(&percpu_desc_ptr, &cpus[CPU_BSP]);
+	asm volatile ("movw %w0, %%gs" : : "r"(KERNEL_PERCPU));
+	kernel_lock();
+}
+
+/* smp_init
+ * Finds the other CPUs in the MP configuration table
+ * Inputs: none
+ * Outputs: none
+ * Effects: fills in cpus[] and num_cpus, copies the AP start-up code to
+ *          SMP_TRAMPOLINE; stays a uniprocessor without a local APIC or table
+ * Called before paging_init, which unmaps the BIOS areas it reads.
+ */
+void smp_init(void) {
+	uint32_t ebda = *(uint16_t*)PHYS_TO_VIRT(BDA_EBDA) << 4;
+	uint32_t base_kb = *(uint16_t*)PHYS_TO_VIRT(BDA_BASE_KB);
+	mp_float* mp = NULL;
+	mp_config* config;
+	mp_processor* cpu;
+	uint8_t* entry;
+	uint32_t i;
+
+	if (!apic_present())
+		return;
+
+	// first KB of the EBDA, last KB of base memory, then the BIOS ROM
+	if (ebda != 0)
+		mp = mp_scan(ebda, KB_1);
+	if (mp == NULL && base_kb != 0)
+		mp = mp_scan(base_kb * KB_1 - KB_1, KB_1);
+	if (mp == NULL)
+		mp = mp_scan(BIOS_ROM, BIOS_ROM_SIZE);
+	if (mp == NULL || mp->features[0] != 0 || mp->config == 0 || mp->config >= MB_8)
+		return;
+
+	config = (mp_config*)PHYS_TO_VIRT(mp->config);
+	if (strncmp(config->signature, (int8_t*)"PCMP", 4) != 0 || mp_checksum(config, config->length) != 0)
+		return;
+
+	entry = (uint8_t*)(config + 1);
+	for (i = 0; i < config->entries; i++) {
+		if (*entry != MP_PROCESSOR) {
+			entry += MP_ENTRY_SIZE;		// bus, I/O APIC or interrupt assignment
+			continue;
+		}
+		cpu = (mp_processor*)entry;
+		entry += sizeof(mp_processor);
+		if (!(cpu->flags & MP_CPU_ENABLED))
+			continue;
+		if (cpu->flags & MP_CPU_BSP)
+			cpus[CPU_BSP].apic_id = cpu->apic_id;
+		else if (num_cpus < MAX_CPUS)
+			cpus[num_cpus++].apic_id = cpu->apic_id;
+	}
+
+	if (num_cpus > 1)
+		memcpy((void*)PHYS_TO_VIRT(SMP_TRAMPOLINE), smp_trampoline, smp_trampoline_end - smp_trampoline);
+}
+
+/* mp_scan
+ * Looks for the MP floating pointer structure
+ * Inputs: start - physical address to start at
+ *         len - bytes to search
+ * Outputs: the structure, NULL if it isn't there
+ */
+static mp_float* mp_scan(uint32_t start, uint32_t len) {
+	uint32_t addr;
+	mp_float* mp;
+
+	for (addr = start; addr + sizeof(mp_float) <= start + len; addr += MP_ALIGN) {
+		mp = (mp_float*)PHYS_TO_VIRT(addr);
+		if (strncmp(mp->signature, (int8_t*)"_MP_", 4) == 0 && mp_checksum(mp, mp->length * MP_ALIGN) == 0)
+			return mp;
+	}
+	return NULL;
+}
+
+/* mp_checksum
+ * Inputs: table - MP table
+ *         len - its size in bytes
+ * Outputs: sum of its bytes, 0 for a valid table
+ */
+static uint8_t mp_checksum(void* table, uint32_t len) {
+	uint8_t* byte = (uint8_t*)table;
+	uint8_t sum = 0;
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		sum += byte[i];
+	return sum;
+}
+
+/* smp_boot
+ * Starts every CPU smp_init found
+ * Inputs: none
+ * Outputs: none
+ * Effects: sends each AP INIT and two STARTUP IPIs (Intel MP specification
+ *          B.4), and waits for it to reach its idle task
+ * The APs spin on the kernel lock until the BSP first lets go of it.
+ * The BSP's local APIC is already enabled by apic_timer_init.
+ */
+void smp_boot(void) {
+	uint32_t i, waited;
+
+	if (num_cpus == 1)
+		return;
+	cpus[CPU_BSP].apic_id = apic_id();
+
+	for (i = 1; i < num_cpus; i++) {
+		ap_booting = &cpus[i];
+		smp_ap_stack = (uint32_t)&ap_stacks[i][AP_STACK_SIZE / 4];
+
+		apic_ipi(cpus[i].apic_id, APIC_ICR_INIT | APIC_ICR_ASSERT | APIC_ICR_LEVEL);
+		apic_ipi(cpus[i].apic_id, APIC_ICR_INIT | APIC_ICR_LEVEL);
+		pit_delay(INIT_DELAY_US);
+		apic_ipi(cpus[i].apic_id, APIC_ICR_STARTUP | (SMP_TRAMPOLINE >> 12));
+		pit_delay(SIPI_DELAY_US);
+		apic_ipi(cpus[i].apic_id, APIC_ICR_STARTUP | (SMP_TRAMPOLINE >> 12));
+
+		for (waited = 0; !cpus[i].online && waited < AP_TIMEOUT_US; waited += SIPI_DELAY_US)
+			pit_delay(SIPI_DELAY_US);
+		if (!cpus[i].online)
+			printf("CPU %d (APIC %d) did not start\n", i, cpus[i].apic_id);
+	}
+}
+
+/* smp_ap_main
+ * Sets up an AP, which ap_start left on the kernel's GDT and boot paging
+ * Inputs: none
+ * Outputs: never returns
+ * Effects: loads the kernel page directory, a GDT of its own with its own
+ *          TSS and cpu_t, and enables its local APIC, then goes idle
+ */
+void smp_ap_main(void) {
+	cpu_t* cpu = ap_booting;
+	x86_desc_t gdtr;
+
+	enable_paging((uint32_t*)VIRT_TO_PHYS(page_directory.tables));
+
+	memcpy(cpu->gdt, gdt, sizeof(cpu->gdt));
+	tss_desc(&cpu->gdt[KERNEL_TSS >> 3], &cpu->ap_tss);
+	percpu_desc(&cpu->gdt[KERNEL_PERCPU >> 3], cpu);
+	gdtr.size = sizeof(cpu->gdt) - 1;
+	gdtr.addr = (uint32_t)cpu->gdt;
+	lgdt(&gdtr.size);
+	asm volatile ("movw %w0, %%gs" : : "r"(KERNEL_PERCPU));
+
+	cpu->ap_tss.ldt_segment_selector = KERNEL_LDT;
+	cpu->ap_tss.ss0 = KERNEL_DS;
+	lldt(KERNEL_LDT);
+	ltr(KERNEL_TSS);
+	apic_init();
+
+	cpu->online = 1;
+	kernel_lock();
+	sched_exit();
+}
+
+/* percpu_desc
+ * Builds the KERNEL_PERCPU descriptor of a CPU
+ * Inputs: desc - GDT entry
+ *         cpu - the CPU's state
+ * Outputs: none
+ * Effects: a kernel data segment covering just the cpu_t
+ */
+static void percpu_desc(seg_desc_t* desc, cpu_t* cpu) {
+	seg_desc_t the_desc;
+
+	the_desc.granularity = 0x0;
+	the_desc.opsize      = 0x1;
+	the_desc.reserved    = 0x0;
+	the_desc.avail       = 0x0;
+	the_desc.present     = 0x1;
+	the_desc.dpl         = 0x0;
+	the_desc.sys         = 0x1;
+	the_desc.type        = 0x2;		// read-write data
+
+	SET_TSS_PARAMS(the_desc, cpu, sizeof(cpu_t) - 1);
+	*desc = the_desc;
+}
+
+/* tss_desc
+ * Builds the TSS descriptor of an AP, like kernel.c does the BSP's
+ * Inputs: desc - GDT entry
+ *         cpu_tss - the AP's TSS
+ * Outputs: none
+ */
+static void tss_desc(seg_desc_t* desc, tss_t* cpu_tss) {
+	seg_desc_t the_desc;
+
+	the_desc.granularity = 0x0;
+	the_desc.opsize      = 0x0;
+	the_desc.reserved    = 0x0;
+	the_desc.avail       = 0x0;
+	the_desc.present     = 0x1;
+	the_desc.dpl         = 0x0;
+	the_desc.sys         = 0x0;
+	the_desc.type        = 0x9;		// available 32-bit TSS
+
+	SET_TSS_PARAMS(the_desc, cpu_tss, TSS_SIZE - 1);
+	*desc = the_desc;
+}
+
+/* kernel_lock
+ * Takes the big kernel lock
+ * Inputs: none
+ * Outputs: none
+ * Effects: spins until no other CPU holds it
+ * A CPU holds it whenever it runs kernel code, except while it halts in
+ * kernel_halt. The scheduler, consoles and file system also have locks of
+ * their own (see lock.h), but every system call still enters under this
+ * one, so those never contend yet. execute still relies on cli/sti around
+ * pipeline_load, spawn, waitpid, pipes and futexes on cli_and_save and
+ * frames.c on cli alone; none of them is safe without this lock until it
+ * moves to a lock of its own.
+ */
+void kernel_lock(void) {
+	spin_lock(&kernel_spinlock);
+}
+
+/* kernel_unlock
+ * Lets go of the big kernel lock
+ * Inputs: none
+ * Outputs: none
+ */
+void kernel_unlock(void) {
+	spin_unlock(&kernel_spinlock);
+}
+
+/* kernel_enter
+ * Takes the kernel lock on entry from an interrupt, exception or system call
+ * Inputs: ctx - registers the entry saved
+ * Outputs: none
+ * Effects: only entries from user space or from kernel_halt need it, any
+ *          other kernel code already holds it; an entry from user space
+ *          ends the process's user time (see sched_acct)
+ * Called with interrupts disabled.
+ */
+void kernel_enter(hw_context* ctx) {
+	if ((ctx->cs & 0x3) || ctx->eip == (uint32_t)kernel_halted)
+		kernel_lock();
+	if (ctx->cs & 0x3) {
+		sched_acct(ACCT_USER);
+		if (ctx->vector == SYSCALL_NUMBER)
+			sched_usage(this_cpu()->pid)->syscalls++;
+	}
+}
+
+/* kernel_leave
+ * Lets go of the kernel lock before returning to user space or kernel_halt
+ * Inputs: ctx - registers about to be restored
+ * Outputs: none
+ * Effects: a return to user space ends the process's kernel time
+ * Called with interrupts disabled, the context may have moved to another
+ * CPU since kernel_enter.
+ */
+void kernel_leave(hw_context* ctx) {
+	if (ctx->cs & 0x3)
+		sched_acct(ACCT_KERNEL);
+	if ((ctx->cs & 0x3) || ctx->eip == (uint32_t)kernel_halted)
+		kernel_unlock();
+}
+
+/* smp_kick
+ * Sends another CPU a reschedule IPI
+ * Inputs: cpu - cpus[] index
+ * Outputs: none
+ * Effects: none for the running CPU or one that isn't online
+ */
+void smp_kick(uint32_t cpu) {
+	if (cpu == this_cpu()->id || cpu >= num_cpus || !cpus[cpu].online)
+		return;
+	apic_ipi(cpus[cpu].apic_id, APIC_ICR_FIXED | APIC_ICR_ASSERT | IPI_VECTOR);
+}
+
+/* ipi_handler
+ * Handles a reschedule IPI
+ * Inputs: none
+ * Outputs: none
+ * Effects: refreshes the vidmap page (the display may have moved to
+ *          another terminal) and runs the scheduler; an idle CPU goes back
+ *          to its idle task, which takes the work that was queued
+ */
+void ipi_handler(void) {
+	apic_eoi();
+	video_paging();
+	scheduler();
+}
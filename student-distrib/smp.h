@@ -0,0 +1,139 @@
+/* smp.h - Defines for multiprocessor support
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "types.h"
+#include "x86_desc.h"
+#include "signal.h"
+
+#define MAX_CPUS        8
+#define CPU_BSP         0       // cpus[] index of the boot processor
+#define SMP_TRAMPOLINE  0x8000  // physical page the other CPUs start in (real mode)
+#define AP_STACK_SIZE   4096    // stack an AP runs smp_ap_main on
+
+/* MP specification tables, see https://wiki.osdev.org/Symmetric_Multiprocessing */
+#define BDA_EBDA        0x40E   // BIOS data area word holding the EBDA segment
+#define BDA_BASE_KB     0x413   // BIOS data area word holding the KB of base memory
+#define BIOS_ROM        0xF0000
+#define BIOS_ROM_SIZE   0x10000
+#define MP_ALIGN        16      // the floating pointer is on a 16 byte boundary
+#define MP_PROCESSOR    0       // configuration table entry types
+#define MP_ENTRY_SIZE   8       // size of every entry but a processor's
+#define MP_CPU_ENABLED  0x1
+#define MP_CPU_BSP      0x2
+
+/* AP start-up delays (Intel MP specification B.4) */
+#define INIT_DELAY_US   10000
+#define SIPI_DELAY_US   200
+#define AP_TIMEOUT_US   100000
+
+/* offsets in a cpu_t for assembly, reached through %gs */
+#define CPU_SELF        0
+#define CPU_TSS         4
+
+#ifndef ASM
+
+/* MP floating pointer structure */
+typedef struct __attribute__((packed)) mp_float_t {
+	int8_t signature[4];		// "_MP_"
+	uint32_t config;			// physical address of the configuration table
+	uint8_t length;				// in 16 byte units
+	uint8_t revision;
+	uint8_t checksum;			// all bytes add up to 0
+	uint8_t features[5];		// features[0] is a default configuration, without a table
+} mp_float;
+
+/* MP configuration table header, followed by the entries */
+typedef struct __attribute__((packed)) mp_config_t {
+	int8_t signature[4];		// "PCMP"
+	uint16_t length;			// of the header and the entries
+	uint8_t revision;
+	uint8_t checksum;
+	int8_t oem[8];
+	int8_t product[12];
+	uint32_t oem_table;
+	uint16_t oem_size;
+	uint16_t entries;
+	uint32_t apic_addr;
+	uint16_t ext_length;
+	uint8_t ext_checksum;
+	uint8_t reserved;
+} mp_config;
+
+/* MP configuration table entry of a processor */
+typedef struct __attribute__((packed)) mp_processor_t {
+	uint8_t type;				// MP_PROCESSOR
+	uint8_t apic_id;
+	uint8_t apic_version;
+	uint8_t flags;				// MP_CPU_ENABLED, MP_CPU_BSP
+	uint32_t signature;
+	uint32_t features;
+	uint32_t reserved[2];
+} mp_processor;
+
+/* state of one CPU, the KERNEL_PERCPU segment (%gs) of a CPU points at its own */
+typedef struct cpu_t {
+	struct cpu_t* self;			// this_cpu() reads it through %gs
+	tss_t* tss;					// context_switch sets its esp0
+	uint32_t id;				// index in cpus
+	uint32_t apic_id;			// local APIC id
+	volatile uint32_t online;	// 1 once the CPU runs the scheduler
+	int32_t pid;				// running process (cur_pid), -1 for none
+	uint8_t terminal;			// terminal of the running process (cur_terminal)
+	uint32_t timer_interrupts;	// local APIC timer interrupts
+	tss_t ap_tss;				// TSS of an AP, the BSP uses tss
+	seg_desc_t gdt[GDT_ENTRIES];	// GDT of an AP, the BSP uses gdt
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t num_cpus;		// CPUs found in the MP table, 1 without one
+
+/* this_cpu
+ * Inputs: none
+ * Outputs: state of the running CPU
+ * Volatile: a process can move to another CPU between two calls.
+ */
+static inline cpu_t* this_cpu(void) {
+	cpu_t* cpu;
+
+	asm volatile ("movl %%gs:0, %0" : "=r"(cpu));
+	return cpu;
+}
+
+/* sets up %gs for the boot CPU, before anything uses cur_pid or cur_terminal */
+void smp_bsp_init(void);
+
+/* finds the other CPUs and copies their start code, while low memory is still mapped */
+void smp_init(void);
+
+/* starts the other CPUs, after paging and before interrupts are enabled */
+void smp_boot(void);
+
+/* big kernel lock, held by a CPU whenever it runs kernel code */
+void kernel_lock(void);
+void kernel_unlock(void);
+
+/* sends a reschedule IPI */
+void smp_kick(uint32_t cpu);
+
+/* called from isr.S */
+void kernel_enter(hw_context* ctx);
+void kernel_leave(hw_context* ctx);
+void ipi_handler(void);
+
+/* entered from ap_start on each AP */
+void smp_ap_main(void);
+
+/* smpasm.S */
+extern uint8_t smp_trampoline[];
+extern uint8_t smp_trampoline_end[];
+extern uint32_t smp_ap_stack;
+void kernel_halt(void);
+void kernel_halted(void);
+
+#endif
+
+#endif
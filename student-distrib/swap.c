@@ -0,0 +1,78 @@
+/* swap.c - Functionality for the swap area
+ * vim:ts=4 noexpandtab
+ */
+
+#include "swap.h"
+#include "ata.h"
+#include "lib.h"
+
+static uint32_t swap_bitmap[SWAP_WORDS];    // 1 bit per slot, set when the slot holds a page
+static uint32_t swap_slots = 0;             // number of usable slots
+
+/* swap_init
+ * Initializes the swap area
+ * Inputs: none
+ * Outputs: number of 4 KB slots available, 0 if no swap disk is attached
+ * Effects: marks every slot as free
+ */
+uint32_t swap_init(void) {
+	uint32_t i;
+
+	swap_slots = ata_init() / SWAP_SLOT_SECTORS;
+	if (swap_slots > SWAP_MAX_SLOTS)
+		swap_slots = SWAP_MAX_SLOTS;
+	for (i = 0; i < SWAP_WORDS; i++)
+		swap_bitmap[i] = 0;
+
+	return swap_slots;
+}
+
+/* swap_out
+ * Writes a page to the swap area
+ * Inputs: addr - kernel virtual address of the page
+ * Outputs: slot holding the page, -1 if swap is full or the write failed
+ * Effects: busy waits on the disk
+ */
+int32_t swap_out(uint32_t addr) {
+	uint32_t slot;
+
+	for (slot = 0; slot < swap_slots; slot++) {
+		if (!(swap_bitmap[slot / SWAP_WORD_BITS] & (1 << (slot % SWAP_WORD_BITS))))
+			break;
+	}
+	if (slot == swap_slots)
+		return -1;
+
+	if (ata_write(slot * SWAP_SLOT_SECTORS, SWAP_SLOT_SECTORS, (const void*)addr) == -1)
+		return -1;
+	swap_bitmap[slot / SWAP_WORD_BITS] |= (1 << (slot % SWAP_WORD_BITS));
+	return slot;
+}
+
+/* swap_in
+ * Reads a page back from the swap area
+ * Inputs: slot - slot returned by swap_out
+ *         addr - kernel virtual address to read the page into
+ * Outputs: 0 on success, -1 if the read failed
+ * Effects: releases the slot on success, busy waits on the disk
+ */
+int32_t swap_in(uint32_t slot, uint32_t addr) {
+	if (slot >= swap_slots)
+		return -1;
+	if (ata_read(slot * SWAP_SLOT_SECTORS, SWAP_SLOT_SECTORS, (void*)addr) == -1)
+		return -1;
+	swap_free(slot);
+	return 0;
+}
+
+/* swap_free
+ * Releases a slot
+ * Inputs: slot - slot returned by swap_out
+ * Outputs: none
+ * Effects: ignores slots outside the swap area
+ */
+void swap_free(uint32_t slot) {
+	if (slot >= swap_slots)
+		return;
+	swap_bitmap[slot / SWAP_WORD_BITS] &= ~(1 << (slot % SWAP_WORD_BITS));
+}
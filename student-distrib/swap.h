@@ -0,0 +1,27 @@
+/* swap.h - Defines for the swap area
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SWAP_H
+#define _SWAP_H
+
+#include "types.h"
+
+// the swap area is the whole disk on the primary slave (e.g. qemu -hdb swap.img)
+#define SWAP_PAGE_SIZE      4096
+#define SWAP_SLOT_SECTORS   (SWAP_PAGE_SIZE / 512)  // sectors per swapped page
+#define SWAP_MAX_SLOTS      8192                    // at most 32 MB of swap is used
+#define SWAP_WORD_BITS      32
+#define SWAP_WORDS          (SWAP_MAX_SLOTS / SWAP_WORD_BITS)
+
+/* finds the swap disk, returns the number of usable slots (0 if there is no swap) */
+uint32_t swap_init(void);
+
+/* writes a page to a free slot, returns the slot or -1 if swap is full */
+int32_t swap_out(uint32_t addr);
+/* reads a page back and releases its slot, 0 on success and -1 on error */
+int32_t swap_in(uint32_t slot, uint32_t addr);
+/* releases a slot without reading it */
+void swap_free(uint32_t slot);
+
+#endif
@@ -12,6 +12,9 @@
 /* set up the iret stack and jump to user process */
 extern int32_t iret_stack(uint32_t *);
 
+/* iret to a new thread at eip on user stack esp */
+extern void iret_thread(uint32_t eip, uint32_t esp);
+
 /* stack switch back to parent process */
 extern void halt_return(int32_t, PCB *);
 
@@ -14,6 +14,10 @@
 #include "paging.h"
 #include "terminals.h"
 #include "scheduling.h"
+#include "frames.h"
+#include "pipe.h"
+#include "thread.h"
+#include "signal.h"
 
 /* Set file operations table for each type */
 file_ops rtc_fops = {rtc_open, rtc_read, rtc_write, rtc_close};
@@ -23,9 +27,17 @@ file_ops terminal_fops = {terminal_open, terminal_read, terminal_write, terminal
 file_ops stdin_fops = {terminal_open, terminal_read, NULL, terminal_close};
 file_ops stdout_fops = {terminal_open, NULL, terminal_write, terminal_close};
 
-int cur_pid = 0;				// current process id
 int pid_status[MAX_PROCESSES];	// checks which processes are active
 
+static wait_queue child_wait[MAX_PROCESSES];	// per process, woken when one it spawned halts
+
+static int32_t pipeline_load(const uint8_t* command, int32_t* pids, uint32_t detached);
+static int32_t process_load(const uint8_t* command, uint32_t detached);
+static void process_unload(int32_t pid);
+static void process_start(void);
+static void spawn_orphan(int32_t pid);
+static void halt_release(int32_t pid);
+
 /* halt
  * Halts current process
  * Inputs: status - status code to send back to execute
@@ -41,14 +53,249 @@ int32_t halt(uint8_t status) {
  * Inputs: command - space separated sequence of words
 					 first word is file name of executable
 					 rest of the words are args handled by getargs()
+					 stages separated by '|' run at once, each one's
+					 stdout piped into the next one's stdin
  * Outputs: 0 on success, -1 on failure
- * Effects: executes a process
+ * Effects: executes a process, returns what the last stage halts with
  */
 int32_t execute(const uint8_t* command) {
 	if (command == NULL) { /* valid pointer check */
 		return -1;
 	}
+	// threads can't wait for a child, halt returns to the process that executed it
+	if (cur_pid >= 0 && PCB_ADDR(cur_pid)->mm_pid != cur_pid) {
+		return -1;
+	}
+
+	int32_t pids[PIPELINE_MAX];			// process of each stage
+	int32_t stages, new_pid, k;
+
+	// nothing runs until all of them are loaded, so a bad stage starts none
+	cli();
+	if ((stages = pipeline_load(command, pids, 0)) == -1) {
+		if (cur_pid >= 0 && pid_status[cur_pid] == 1)
+			paging_syscall(cur_pid);	// restore caller paging
+		sti();
+		return -1;
+	}
+	for (k = 0; k < stages - 1; k++)
+		sched_start(pids[k], process_start);
+
+	// the last stage was loaded last, so its paging is the one set up
+	new_pid = pids[stages - 1];
+	PCB *pcb = PCB_ADDR(new_pid);
+
+	// the caller is the parent, halt returns to it on this stack
+	if (execute_link(new_pid) == 0) {
+		// store esp and ebp in the PCB
+		uint32_t esp, ebp;
+		asm volatile("movl %%esp, %0":"=g"(esp));
+		pcb->parent->esp = esp;
+		asm volatile("movl %%ebp, %0":"=g"(ebp));
+		pcb->parent->ebp = ebp;
+	}
+	sched_charge();		// the caller's time up to here is its own
+	if (cur_pid >= 0)
+		sched_usage(cur_pid)->nvcsw++;	// waits for its child
+	cur_pid = new_pid;	// the parent stays off the run queue until its child halts
+	sched_timer();		// a shell launched by sched_launch shares with whoever it preempted
+	printf("Terminal %d running %d processes, executing pid %d\n", cur_terminal, terminals[pcb->tid].running_processes, new_pid);
+
+	// set tss pointer
+	this_cpu()->tss->ss0 = KERNEL_DS; // set ss0 to kernel's stack segment
+	this_cpu()->tss->esp0 = KERNEL_STACKS - (KB_8*new_pid) - 4; // set esp0 to bottom of process's kernel stack
+
+	sti();
+	// switch to user process (will return value from halt)
+	return iret_stack((uint32_t*)pcb->eip);
+}
+
+/* execute_link
+ * Makes the calling process the parent of a process it executed
+ * Inputs: pid - the new process
+ * Outputs: 0 if it has a parent to return to, -1 for the first shell of a
+ *          terminal (nothing called execute, or the caller is halting)
+ * Effects: the new process becomes its terminal's foreground process only
+ *          if the caller was, a background job's children stay its own
+ * Call with interrupts disabled.
+ */
+int32_t execute_link(int32_t pid) {
+	PCB* pcb = PCB_ADDR(pid);
+	terminal* term = &terminals[pcb->tid];
+	int32_t linked = -1;
+
+	pcb->parent = NULL;
+	pcb->child = NULL;
+	if (cur_pid >= 0 && pid_status[cur_pid] == 1) {
+		pcb->parent = PCB_ADDR(cur_pid);
+		pcb->parent->child = pcb;
+		linked = 0;
+	}
+
+	// a halting shell passes the terminal on to the shell that replaces it
+	if (cur_pid < 0 || term->pid == cur_pid) {
+		term->pid = pid;
+		term->pcb = pcb;
+		term->running_processes++;
+	}
+	return linked;
+}
+
+/* spawn
+ * Starts a process without waiting for it
+ * Inputs: command - same as for execute, pipelines included
+ * Outputs: pid of the (last stage's) process on success, -1 on failure
+ * Effects: the caller keeps running; waitpid collects what the process
+ *          halts with, until then its pid stays taken
+ */
+int32_t spawn(const uint8_t* command) {
+	int32_t pids[PIPELINE_MAX];
+	int32_t stages, k;
+	uint32_t flags;
+
+	if (command == NULL || cur_pid < 0)
+		return -1;
+
+	cli_and_save(flags);
+	stages = pipeline_load(command, pids, 1);
+	// loading leaves the new process's paging set up
+	paging_syscall(PCB_ADDR(cur_pid)->mm_pid);
+	if (stages == -1) {
+		restore_flags(flags);
+		return -1;
+	}
+	PCB_ADDR(pids[stages - 1])->waiter = PCB_ADDR(cur_pid)->mm_pid;
+	for (k = 0; k < stages; k++) {
+		PCB_ADDR(pids[k])->tid = PCB_ADDR(cur_pid)->tid;	// not the terminal on screen
+		sched_start(pids[k], process_start);
+	}
+	restore_flags(flags);
+	return pids[stages - 1];
+}
+
+/* waitpid
+ * Collects the exit status of a spawned process
+ * Inputs: pid - process from spawn, -1 for any of them
+ *         status - where to store what it halted with (256 on an exception), may be NULL
+ *         options - WNOHANG to return 0 instead of sleeping while it runs
+ * Outputs: pid collected, 0 (WNOHANG only) if none has halted yet,
+ *          -1 if the caller has no such process
+ * Effects: frees the pid of the process collected
+ */
+int32_t waitpid(int32_t pid, int32_t* status, int32_t options) {
+	int32_t mm = PCB_ADDR(cur_pid)->mm_pid;
+	int32_t i, found, exit_status;
+	uint32_t flags;
+
+	if (pid < -1 || pid >= MAX_PROCESSES)
+		return -1;
+	if (status != NULL && (status < (int32_t*)IMAGE_START || status >= (int32_t*)KERNEL_BASE))
+		return -1;
+
+	cli_and_save(flags);
+	while (1) {
+		found = 0;
+		spin_lock(&sched_lock);
+		for (i = 0; i < MAX_PROCESSES; i++) {
+			if (pid != -1 && i != pid)
+				continue;
+			if (pid_status[i] != 1 && pid_status[i] != PID_EXITING && pid_status[i] != PID_ZOMBIE)
+				continue;
+			if (PCB_ADDR(i)->waiter != mm)
+				continue;
+			if (pid_status[i] == PID_ZOMBIE) {
+				// read before the pid is freed, execute can reuse its PCB right after
+				exit_status = PCB_ADDR(i)->exit_status;
+				pid_status[i] = -1;
+				spin_unlock_irqrestore(&sched_lock, flags);
+				if (status != NULL)
+					*status = exit_status;
+				return i;
+			}
+			found = 1;		// still running or halting
+		}
+		spin_unlock(&sched_lock);
+		if (!found || (options & WNOHANG)) {
+			restore_flags(flags);
+			return found ? 0 : -1;
+		}
+		sched_sleep(&child_wait[mm]);
+	}
+}
+
+/* pipeline_load
+ * Loads the stages of a command and joins them with pipes
+ * Inputs: command - stages separated by '|'
+ *         pids - gets the process of each stage
+ *         detached - 1 if nobody waits in execute for the last stage
+ * Outputs: number of stages, -1 on failure (nothing is left loaded)
+ * Effects: leaves the paging of the last stage set up
+ * Call with interrupts disabled.
+ */
+static int32_t pipeline_load(const uint8_t* command, int32_t* pids, uint32_t detached) {
+	uint8_t stage[MAX_COMMAND_LEN+1];	// command of one pipeline stage
+	int32_t pipes[PIPELINE_MAX - 1];	// pipe after each stage but the last
+	int32_t stages = 1;
+	int32_t k, len;
+	int i = 0;
+
+	for (i = 0; command[i] != '\0' && command[i] != '\n'; i++) {
+		if (command[i] == '|')
+			stages++;
+	}
+	if (stages > PIPELINE_MAX) {
+		printf("Pipeline is too long\n");
+		return -1;
+	}
+
+	/* CREATE PIPES */
+	for (k = 0; k < stages - 1; k++) {
+		if ((pipes[k] = pipe_create()) == -1) {
+			puts("Out of pipes!\n");
+			while (k-- > 0)
+				pipe_release(pipes[k]);
+			return -1;
+		}
+	}
+
+	/* LOAD EVERY STAGE */
+	i = 0;
+	for (k = 0; k < stages; k++) {
+		for (len = 0; command[i] != '\0' && command[i] != '\n' && command[i] != '|'; i++) {
+			if (len < MAX_COMMAND_LEN)
+				stage[len++] = command[i];
+		}
+		stage[len] = '\0';
+		i++;	// past the '|'
+
+		// every stage but the last runs on its own, the caller waits for the last
+		if ((pids[k] = process_load(stage, k < stages - 1 || detached)) == -1) {
+			while (k-- > 0)
+				process_unload(pids[k]);
+			for (k = 0; k < stages - 1; k++)
+				pipe_release(pipes[k]);
+			return -1;
+		}
+	}
+
+	for (k = 0; k < stages - 1; k++) {
+		pipe_attach(pids[k], STDOUT_IDX, pipes[k], PIPE_WRITE_END);
+		pipe_attach(pids[k + 1], STDIN_IDX, pipes[k], PIPE_READ_END);
+	}
+	return stages;
+}
 
+/* process_load
+ * Loads a program into a new process
+ * Inputs: command - file name of the executable followed by its args
+ *         detached - 1 if nobody waits in execute for it (a pipeline stage
+ *                    that isn't the last, or spawned), it then halts without
+ *                    returning to a parent
+ * Outputs: pid of the new process, -1 on failure
+ * Effects: leaves the paging of the new process set up
+ * Call with interrupts disabled.
+ */
+static int32_t process_load(const uint8_t* command, uint32_t detached) {
 	/* PARSE ARGUMENTS */
 	uint32_t filename_len = 0;			  // length of the file name to be executed
 	uint32_t args_len = 0;				  // length of the word sequence of command arguments
@@ -82,6 +329,9 @@ int32_t execute(const uint8_t* command) {
 		args_len++;
 		i++;
 	}
+	// trailing spaces come from the space before a '|'
+	while (args_len > 0 && args[args_len - 1] == ' ')
+		args_len--;
 	args[args_len] = '\0'; // end string with null-terminator
 
 	printf("Execute file: %s\n", filename);
@@ -95,30 +345,34 @@ int32_t execute(const uint8_t* command) {
 
 	/* SET UP PAGING */
 	// look for an inactive process ID and claim it
-	int cur_pid = find_avail_pid();
-	if (cur_pid == -1) {
+	int new_pid = pid_claim();
+	if (new_pid == -1) {
 		puts("Too many processes running!\n");
 		return -1;
 	}
-	else {
-		pid_status[cur_pid] = 1;
-	}
-
-	cli();
-	
-	// set up user program page
-	paging_syscall(cur_pid);
 
 	/* LOAD FILE INTO MEMORY */
-	// copy the file to memory starting at virtual address 0x08048000
-	copy_to_va(filename, PROGRAM_IMAGE_ADDR, MB_4);
+	// set up user program pages and copy the file to 0x08048000
+	if (paging_load(new_pid, filename) == -1) {
+		puts("Out of memory!\n");
+		paging_free(new_pid);
+		pid_status[new_pid] = -1;
+		return -1;
+	}
 
 	/* CREATE PCB */
-	PCB *pcb = (PCB*)(MB_8 - KB_8*(cur_pid + 1)); 
-	pcb->pid = cur_pid;
+	PCB *pcb = PCB_ADDR(new_pid);
+	pcb->pid = new_pid;
 	pcb->tid = cur_terminal;
+	pcb->heap_brk = HEAP_START;	// empty heap, pages are mapped on first touch
+	pcb->detached = detached;
+	pcb->mm_pid = new_pid;
+	pcb->waiter = -1;
+	signal_reset(new_pid);
 
 	// initialize stdin and stdout
+	for (i = 0; i < FDA_SIZE; i++)
+		pcb->file_array[i].flags = NOT_IN_USE;
 	(pcb->file_array[STDIN_IDX]).fops_table = stdin_fops;
 	(pcb->file_array[STDIN_IDX]).flags = 1;
 	(pcb->file_array[STDOUT_IDX]).fops_table = stdout_fops;
@@ -126,37 +380,36 @@ int32_t execute(const uint8_t* command) {
 
 	// copy args 
 	strcpy((int8_t*)pcb->exe_args, (const int8_t*)args);
+	strncpy((int8_t*)pcb->name, (const int8_t*)filename, PCB_NAME_SIZE - 1);
+	pcb->name[PCB_NAME_SIZE - 1] = '\0';
 
-	// parent of this process is the last pcb set
-	if (terminals[cur_terminal].pid != -1) { // if parent process exists
-		// set parent/child pcb pointers
-		PCB* parent_pcb = terminals[pcb->tid].pcb;
-		parent_pcb->child = pcb;
-		pcb->parent = parent_pcb;
-		// store esp and ebp in the PCB
-		uint32_t esp, ebp;
-		asm volatile("movl %%esp, %0":"=g"(esp));
-		parent_pcb->esp = esp;
-		asm volatile("movl %%ebp, %0":"=g"(ebp));
-		parent_pcb->ebp = ebp;
-	}
+	// store program's entrypoint
+	pcb->eip = *(uint32_t*)ENTRYPOINT;
 
-	// update terminal PCB information
-	terminals[cur_terminal].pid = cur_pid;
-	terminals[cur_terminal].pcb = pcb;
-	terminals[cur_terminal].running_processes++;
-	printf("Terminal %d running %d processes, executing pid %d\n", cur_terminal, terminals[pcb->tid].running_processes, cur_pid);
+	// inherits the nice level of its parent
+	sched_fork(new_pid, cur_pid);
 
-	// set tss pointer
-	tss.ss0 = KERNEL_DS; // set ss0 to kernel's stack segment
-	tss.esp0 = MB_8 - (KB_8*cur_pid) - 4; // set esp0 to bottom of process's kernel stack
+	return new_pid;
+}
 
-	// store program's entrypoint
-	pcb->eip = *(uint32_t*)ENTRYPOINT;
-	
-	sti();
-	// switch to user process (will return value from halt)
-	return iret_stack((uint32_t*)pcb->eip);
+/* process_unload
+ * Frees a process that was loaded but never ran
+ * Inputs: pid - process from process_load
+ * Outputs: none
+ */
+static void process_unload(int32_t pid) {
+	paging_free(pid);
+	pid_status[pid] = -1;
+}
+
+/* process_start
+ * First code a detached process runs, on its own kernel stack
+ * Inputs: none
+ * Outputs: none
+ * Effects: enters the program in user space, never returns
+ */
+static void process_start(void) {
+	iret_stack((uint32_t*)PCB_ADDR(cur_pid)->eip);
 }
 
 /* read
@@ -172,7 +425,7 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes) {
     /* fd index check and valid buffer/nbytes check */
     if(fd < 0 || fd > FD_MAX || buf == NULL || nbytes < 0) return -1;
 
-    PCB *pcb = terminals[cur_terminal].pcb;
+    PCB *pcb = MM_PCB(cur_pid);
 
     /* check that file is in use and that read operation exists */
     if(pcb->file_array == NULL) return -1;
@@ -195,7 +448,7 @@ int32_t write(int32_t fd, const void* buf, int32_t nbytes) {
     /* fd index check and valid buffer/nbytes check */
     if(fd < 0 || fd > FD_MAX || buf == NULL || nbytes < 0) return -1;
 
-    PCB *pcb = terminals[cur_terminal].pcb;
+    PCB *pcb = MM_PCB(cur_pid);
     
     /* check that file is in use and that write operation exists */
     if(pcb->file_array == NULL) return -1;
@@ -215,7 +468,7 @@ int32_t open(const uint8_t* filename) {
     if(filename == NULL) return -1;
     
     dentry_t dentry;
-    PCB *pcb = terminals[cur_terminal].pcb;
+    PCB *pcb = MM_PCB(cur_pid);
     int i;
     
     /* Find the directory entry corresponding to the filename */
@@ -267,7 +520,7 @@ int32_t close(int32_t fd) {
     /* fd index check */
     if(fd < FD_MIN || fd > FD_MAX) return -1;
     
-    PCB *pcb = terminals[cur_terminal].pcb;
+    PCB *pcb = MM_PCB(cur_pid);
     
     /* check that file is in use and that write operation exists */
     if(pcb->file_array == NULL) return -1;
@@ -292,7 +545,7 @@ int32_t getargs(uint8_t* buf, int32_t nbytes) {
 	/* valid input check */
 	if(buf == NULL || nbytes < 0) return -1;
 
-	PCB *pcb = terminals[cur_terminal].pcb;
+	PCB *pcb = MM_PCB(cur_pid);
 	// no arguments
 	if(pcb->exe_args == NULL || pcb->exe_args[0] == '\0') return -1;
 	
@@ -311,38 +564,45 @@ int32_t getargs(uint8_t* buf, int32_t nbytes) {
 int32_t vidmap(uint8_t** screen_start) {
 	/* Null check */
     if(screen_start == NULL) return -1;
-	/* Make sure double pointer is from user page */
-	if(screen_start >= (uint8_t**)MB_132 || screen_start < (uint8_t**)MB_128)
+	/* Make sure double pointer is from user memory (not the video page or the kernel) */
+	if(screen_start >= (uint8_t**)KERNEL_BASE || screen_start < (uint8_t**)IMAGE_START)
+		return -1;
+	if(screen_start >= (uint8_t**)VIDMAP_ADDR && screen_start < (uint8_t**)(VIDMAP_ADDR + KB_4))
 		return -1;
 
     /* Set up paging */
-	video_paging();
+	if (paging_vidmap(PCB_ADDR(cur_pid)->mm_pid) == -1)
+		return -1;
 
 	/* write into provided location */
-    *screen_start = (uint8_t*)MB_132;  // 132 MB: video memory page for user
+    *screen_start = (uint8_t*)VIDMAP_ADDR;  // video memory page for user
 
     return 0;
 }
 
-/* set_handler
- * System call for signals (unimplemented)
- * Inputs: signum -
- *         handler_address -
- * Outputs: -1 for invalid system call
- * Effects:
+/* sbrk
+ * Moves the end of the heap of the current process
+ * Inputs: increment - number of bytes to grow (or shrink if negative) the heap by
+ * Outputs: previous end of the heap on success, -1 on failure
+ * Effects: growing only reserves addresses, frames are allocated and zeroed
+ *          on first touch; shrinking releases whole pages past the new end
  */
-int32_t set_handler(int32_t signum, void* handler_address) {
-    return -1;
-}
+int32_t sbrk(int32_t increment) {
+	PCB *pcb = MM_PCB(cur_pid);
+	uint32_t old_brk = pcb->heap_brk;
+	uint32_t new_brk = old_brk + increment;
 
-/* sigreturn
- * System call for signals (unimplemented)
- * Inputs: none
- * Outputs: -1 for invalid system call
- * Effects:
- */
-int32_t sigreturn(void) {
-    return -1;
+	/* keep the break inside the heap region (also catches wraparound) */
+	if ((increment > 0 && new_brk < old_brk) || (increment < 0 && new_brk > old_brk))
+		return -1;
+	if (new_brk < HEAP_START || new_brk > HEAP_START + HEAP_MAX)
+		return -1;
+
+	pcb->heap_brk = new_brk;
+	if (increment < 0)
+		heap_free_pages(pcb->pid, new_brk);
+
+	return old_brk;
 }
 
 /* halt_extend
@@ -354,56 +614,133 @@ int32_t sigreturn(void) {
  * This is called by the halt system call (8-bit status) and exception handlers (256 status)
  */
 int32_t halt_extend(int32_t status) {
-	int i;
-	int cur_pid = terminals[cur_terminal].pid;
-	PCB* pcb = terminals[cur_terminal].pcb;
+	int i, foreground, waiter;
+	PCB* pcb = PCB_ADDR(cur_pid);
 
+	sched_charge();
 	printf("Halting PID %d with status %d\n", cur_pid, status);
 
-	// set current process as inactive
-	pid_status[cur_pid] = -1;
+	// a halting process isn't preempted, its pid is only given up once it is torn down
+	pcb->exit_status = status;
+	pid_status[cur_pid] = PID_EXITING;
 
-	// terminate any currently open FDs
+	// a thread only gives back its pid and kernel stack, the rest is its process's
+	if (pcb->mm_pid != cur_pid) {
+		cli();
+		halt_release(cur_pid);
+		sched_exit();
+	}
+
+	// the threads of a process go down with it, what it spawned lives on
+	thread_kill_all(cur_pid);
+	spawn_orphan(cur_pid);
+
+	// terminate any currently open FDs, stdin and stdout too (they may be pipe ends)
 	for (i = 0; i < FDA_SIZE; i++) {
-		if (pcb->file_array[i].flags)
-			close(i);
+		if (pcb->file_array[i].flags && pcb->file_array[i].fops_table.close != NULL) {
+			pcb->file_array[i].flags = NOT_IN_USE;
+			pcb->file_array[i].fops_table.close(i);
+		}
 	}
 
+	// release image, stack and heap pages
+	paging_free(cur_pid);
+
 	// clear args buffer just in case
 	for(i = 0; i < MAX_ARG_SEQ_SIZE; i++) {
         pcb->exe_args[i] = NULL;
     }
 
-	terminals[pcb->tid].running_processes--;
+	// nobody waits in execute for a detached process, the CPU goes to the next one
+	if (pcb->detached) {
+		waiter = pcb->waiter;
+		cli();
+		halt_release(cur_pid);
+		if (waiter >= 0)
+			sched_wake(&child_wait[waiter]);
+		sched_exit();
+	}
+
+	// only the foreground process of a terminal is counted there (see execute_link)
+	foreground = (terminals[pcb->tid].pid == cur_pid);
+	if (foreground)
+		terminals[pcb->tid].running_processes--;
 
 	// execute shell if no parent
-	if (terminals[pcb->tid].running_processes == 0) {
+	if (foreground && terminals[pcb->tid].running_processes == 0) {
 		printf("Re-executing shell...\n");
-		uint8_t cmd[] = "shell";
-		execute(cmd);
+		cli();
+		halt_release(cur_pid);		// the new shell has no parent to return to
+		sched_launch();				// it loads on the terminal's launch stack, not this one
 	}
 	
 	int old_pid = cur_pid;
 
 	PCB* parent_pcb = pcb->parent;
 	parent_pcb->child = NULL;           // clear child from parent
+	if (foreground) {
+		terminals[pcb->tid].pid = parent_pcb->pid;	// update pid in terminal
+		terminals[pcb->tid].pcb = parent_pcb;		// update pcb ptr in terminal
+	}
+	cli();		// the parent can't be preempted on this stack, halt_return enables interrupts
 	cur_pid = parent_pcb->pid;          // set pid and pcb to parent
-	terminals[pcb->tid].pid = cur_pid;		// update pid in terminal
-	terminals[pcb->tid].pcb = parent_pcb;	// update pcb ptr in terminal
 	
 	printf("There are now %d processes in terminal %d...switching from pid %d to pid %d\n", 
 		terminals[cur_terminal].running_processes, cur_terminal, old_pid, cur_pid);
 	
 	paging_syscall(cur_pid);			// restore parent paging
 
-	tss.ss0 = KERNEL_DS;				// switch TSS back to kernel
-	tss.esp0 = MB_8 - KB_8*cur_pid - 4;
+	this_cpu()->tss->ss0 = KERNEL_DS;	// switch TSS back to kernel
+	this_cpu()->tss->esp0 = KERNEL_STACKS - KB_8*cur_pid - 4;
 
+	halt_release(old_pid);
 	halt_return(status, parent_pcb);	// return to execute and immediately return to parent process
 
 	return -1; // should never get here
 }
 
+/* halt_release
+ * Gives up the pid of a process at the end of its halt
+ * Inputs: pid - the process halting, torn down but for the stack it runs on
+ * Outputs: none
+ * Effects: frees the pid, or keeps it as a zombie until waitpid collects
+ *          the status of a spawned process
+ * Another CPU can reuse the pid right away, so this is the last thing halt
+ * does before it leaves the process's kernel stack. Call with interrupts
+ * disabled.
+ */
+static void halt_release(int32_t pid) {
+	spin_lock(&sched_lock);
+	pid_status[pid] = (PCB_ADDR(pid)->waiter >= 0) ? PID_ZOMBIE : -1;
+	spin_unlock(&sched_lock);
+}
+
+/* spawn_orphan
+ * Lets go of the processes a halting process spawned
+ * Inputs: pid - the process halting
+ * Outputs: none
+ * Effects: nobody collects their status anymore, the pids of those
+ *          already halted are freed
+ */
+static void spawn_orphan(int32_t pid) {
+	uint32_t flags;
+	int32_t i;
+
+	// one still halting frees its own pid (see halt_release)
+	spin_lock_irqsave(&sched_lock, flags);
+	for (i = 0; i < MAX_PROCESSES; i++) {
+		if (pid_status[i] != 1 && pid_status[i] != PID_EXITING && pid_status[i] != PID_ZOMBIE)
+			continue;
+		if (PCB_ADDR(i)->waiter != pid)
+			continue;
+		PCB_ADDR(i)->waiter = -1;
+		if (pid_status[i] == PID_ZOMBIE)
+			pid_status[i] = -1;
+	}
+	child_wait[pid].waiting = 0;
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
 /* find_avail_pid
  * Finds and returns the next available pid
  * Inputs: n/a
@@ -412,9 +749,27 @@ int32_t halt_extend(int32_t status) {
 int32_t find_avail_pid() {
 	int j;
 	for (j = 0; j < MAX_PROCESSES; j++) {
-		if (pid_status[j] != 1) {
+		if (pid_status[j] != 1 && pid_status[j] != PID_EXITING && pid_status[j] != PID_ZOMBIE) {
 			return j;
 		}
 	}
 	return -1;
 }
+
+/* pid_claim
+ * Takes the next available pid
+ * Inputs: n/a
+ * Return Value: the pid, now marked active, or -1 if all are taken
+ * Under sched_lock, so two CPUs never take the same pid and a halting
+ * process's pid isn't handed out before halt_release.
+ */
+int32_t pid_claim() {
+	uint32_t flags;
+	int32_t pid;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	if ((pid = find_avail_pid()) != -1)
+		pid_status[pid] = 1;
+	spin_unlock_irqrestore(&sched_lock, flags);
+	return pid;
+}
@@ -9,6 +9,8 @@
 #include "pcb.h"
 #include "filesystem.h"
 #include "paging.h"
+#include "smp.h"
+#include "lock.h"
 
 #define MAX_COMMAND_LEN 100
 #define MAX_FILENAME_LEN 32
@@ -23,16 +25,27 @@
 #define STDIN_IDX     0
 #define STDOUT_IDX    1
 
-#define MAX_PROCESSES 6		// maximum of 6 processes for now
+#define PIPELINE_MAX  4		// stages of a command joined by '|'
+#define MAX_PROCESSES 32	// kernel stacks use the top 256 KB of the kernel page
+
+#define PID_ZOMBIE    2		// pid_status of a halted process whose status waitpid hasn't collected
+#define PID_EXITING   3		// pid_status of a process in the middle of halt, its pid is still taken
+#define WNOHANG       1		// waitpid option: return 0 instead of sleeping
+
+/* PCB of a process, at the bottom of its 8 kB kernel stack */
+#define PCB_ADDR(pid)   ((PCB*)(KERNEL_STACKS - KB_8*((pid) + 1)))
+/* PCB holding the address space and files of a process or thread */
+#define MM_PCB(pid)     PCB_ADDR(PCB_ADDR(pid)->mm_pid)
 
 #define PROGRAM_IMAGE_ADDR	 0x08048000
 #define PROGRAM_IMAGE_OFFSET 24
 #define ENTRYPOINT           (0x08048000 + 24) // entrypoint at bytes 24-27 (32-bit value)
 
-extern int cur_pid;     				// current process id
+#define cur_pid (this_cpu()->pid)			// process running on this CPU, -1 if none
 extern int pid_status[MAX_PROCESSES];	// checks which processes are active
+extern spinlock sched_lock;				// guards pid_status changes (see scheduling.c)
 
-/* system calls 1-10 */
+/* system calls 1-10, set_handler and sigreturn are in signal.c */
 int32_t halt(uint8_t status);
 int32_t execute(const uint8_t* command);
 int32_t read(int32_t fd, void* buf, int32_t nbytes);
@@ -44,8 +57,22 @@ int32_t vidmap(uint8_t** screen_start);
 int32_t set_handler(int32_t signum, void* handler_address);
 int32_t sigreturn(void);
 
+/* system call 11 */
+int32_t sbrk(int32_t increment);
+
+/* system call 16 is pipe, see pipe.h; 17-18 are clone and futex, see thread.h */
+
+/* system calls 19-20 */
+int32_t spawn(const uint8_t* command);
+int32_t waitpid(int32_t pid, int32_t* status, int32_t options);
+
+/* system call 21 is sleep, see timer.h */
+/* system calls 22-23 are rtprio and getrusage, see scheduling.h */
+
 /* helper functions */
 int32_t halt_extend(int32_t status);
+int32_t execute_link(int32_t pid);
 int32_t find_avail_pid();
+int32_t pid_claim();
 
 #endif
@@ -9,9 +9,9 @@
 #include "paging.h"
 #include "scheduling.h"
 
-volatile uint8_t cur_terminal = 0;      // id of currently running terminal
 volatile uint8_t display_terminal = 0;  //  id of currently displaying terminal
 terminal terminals[MAX_TERMINALS];
+spinlock console_lock = SPINLOCK_INIT("console");  // taken with interrupts disabled, the keyboard handler takes it
 
 /* terminal_init
  * initialize terminals
@@ -31,9 +31,10 @@ void terminal_init() {
         terminals[i].screen_x = 0;
         terminals[i].screen_y = 0;
         terminals[i].buffer_idx = 0;
+        terminals[i].line_ready = 0;
         for (j = 0; j < BUF_SIZE; j++)
             terminals[i].kbd_buffer[j] = '\0';
-        terminals[i].video_mem = (int8_t*)VIDEO_ADDR + KB_4*(i+1);
+        terminals[i].video_mem = (int8_t*)PHYS_TO_VIRT(VIDEO_ADDR + KB_4*(i+1));
     }
 }
 
@@ -57,9 +58,11 @@ void terminal_switch(uint8_t tid) {
         return;
     }
     
-    cli();
+    uint32_t flags;
     int i;
 
+    spin_lock_irqsave(&console_lock, flags);
+
     /* save display_terminal information */
     terminals[display_terminal].screen_x = screen_x;           // save cursor
     terminals[display_terminal].screen_y = screen_y;
@@ -73,6 +76,8 @@ void terminal_switch(uint8_t tid) {
     /* change display terminal global var and update paging */
     display_terminal = tid;
     video_paging();
+    for (i = 0; i < num_cpus; i++)
+        smp_kick(i);                            // the other CPUs update theirs in ipi_handler
     
     /* switch to tid display */
     screen_x = terminals[tid].screen_x;           // restore cursor
@@ -83,15 +88,13 @@ void terminal_switch(uint8_t tid) {
     }
     memcpy((uint8_t*)VIDEO, (uint8_t*)terminals[tid].video_mem, 2*NUM_ROWS*NUM_COLS); // restore video memory
     update_cursor();
+    spin_unlock(&console_lock);                  // not held across a switch
 
     /* launch shell in tid for the first time */    
     if (terminals[tid].running_processes == 0) {
-        save_stack(terminals[cur_terminal].pid); // save context of scheduler process
-        cur_terminal = tid;                      // switch to display terminal
-        video_paging();                          // set up video memory paging
-        sti();
-        execute((uint8_t*)"shell");
+        cur_terminal = tid;                      // shell belongs to the display terminal
+        sched_launch();                          // running process resumes here later
     }
     
-    sti();
+    restore_flags(flags);
 }
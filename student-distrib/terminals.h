@@ -8,6 +8,9 @@
 #include "types.h"
 #include "lib.h"
 #include "pcb.h"
+#include "scheduling.h"
+#include "smp.h"
+#include "lock.h"
 
 #define MAX_TERMINALS 3
 
@@ -22,12 +25,15 @@ typedef struct terminal_t {
     char* video_mem;                // video memory
     unsigned char kbd_buffer[BUF_SIZE];    // keyboard buffer
     uint32_t buffer_idx;                   // index in kbd buffer
+    volatile uint8_t line_ready;           // a line was entered and not read yet
+    wait_queue read_wait;                  // processes blocked in terminal_read
 } terminal;
 
 /* global terminal variables */
-extern volatile uint8_t cur_terminal;       // currently executing terminal
+#define cur_terminal (this_cpu()->terminal)         // terminal of the process running on this CPU
 extern volatile uint8_t display_terminal;   // current display terminal (user-control)
 extern terminal terminals[MAX_TERMINALS];   // array to access terminal struct by tid
+extern spinlock console_lock;               // guards the screen, cursors, keyboard buffers and line_ready
 
 /* multiple terminal functions */ 
 void terminal_init();
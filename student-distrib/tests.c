@@ -10,6 +10,21 @@
 #include "filesystem.h"
 #include "keyboard.h"
 #include "systemcall.h"
+#include "frames.h"
+#include "zswap.h"
+#include "scheduling.h"
+#include "pit.h"
+#include "pipe.h"
+#include "thread.h"
+#include "signal.h"
+#include "smp.h"
+#include "apic.h"
+#include "lock.h"
+#include "timer.h"
+#include "terminals.h"
+#include "cr.h"
+#include "shm.h"
+#include "swap.h"
 
 #define PASS 1
 #define FAIL 0
@@ -119,7 +134,7 @@ int negPointer_test() {
 int valPointer_test() {
 	TEST_HEADER;
 	int result = PASS;
-	int * a = (int*) 5000000; // inside kernel range
+	int * a = (int*) PHYS_TO_VIRT(5000000); // inside kernel range
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -143,7 +158,7 @@ int pagingBoundary_test() {
 	int result = PASS;
 	uint8_t * a;
 	// kernel memory address - start
-	a = (uint8_t*) KERNEL_ADDR; 
+	a = (uint8_t*) PHYS_TO_VIRT(KERNEL_ADDR); 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -151,7 +166,7 @@ int pagingBoundary_test() {
 		result = FAIL;
 	}
 	// kernel memory address - end
-	a = (uint8_t*) (KERNEL_ADDR*2 - 1); 
+	a = (uint8_t*) PHYS_TO_VIRT(KERNEL_ADDR*2 - 1); 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -159,7 +174,7 @@ int pagingBoundary_test() {
 		result = FAIL;
 	}
 	// video memory address - start
-	a = (uint8_t*) VIDEO_ADDR; 
+	a = (uint8_t*) PHYS_TO_VIRT(VIDEO_ADDR); 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -167,7 +182,7 @@ int pagingBoundary_test() {
 		result = FAIL;
 	}
 	// video memory address - end
-	a = (uint8_t*) (VIDEO_ADDR+PAGE_SIZE-1); 
+	a = (uint8_t*) PHYS_TO_VIRT(VIDEO_ADDR+PAGE_SIZE-1); 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -191,7 +206,7 @@ int pagingKernelBoundary_test1() {
 	int result = PASS;
 	uint8_t * a;
 	// kernel memory address - 1 addr before start
-	a = (uint8_t*) KERNEL_ADDR-1; 
+	a = (uint8_t*) PHYS_TO_VIRT(KERNEL_ADDR)-1; 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -214,8 +229,8 @@ int pagingKernelBoundary_test2() {
 	TEST_HEADER;
 	int result = PASS;
 	uint8_t * a;
-	// kernel memory address - 1 addr after end
-	a = (uint8_t*) (KERNEL_ADDR*2); 
+	// 1 addr after the end of kernel memory (frame pool follows the kernel page)
+	a = (uint8_t*) PHYS_TO_VIRT(FRAME_POOL_END); 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -225,6 +240,27 @@ int pagingKernelBoundary_test2() {
 	return result;
 }
 
+/* Paging Low Kernel Test
+ * 
+ * Checks that the kernel is no longer reachable at its physical address
+ * once paging_init has replaced the boot page directory
+ * Inputs: None
+ * Outputs: FAIL or infinite loop
+ * Side Effects: Should spin indefinitely on a page fault exception
+ * Coverage: Paging
+ * Files: paging, boot and cr
+ */
+int pagingLowKernel_test() {
+	TEST_HEADER;
+	int result = FAIL;
+	uint8_t * a;
+	// physical address of the kernel, only mapped above KERNEL_BASE
+	a = (uint8_t*) KERNEL_ADDR; 
+	*a = 1;
+	// should never get here
+	return result;
+}
+
 /* Paging Video Memory Boundary Test 1 (Start)
  * 
  * Checks whether video memory paging boundaries are correct
@@ -239,7 +275,7 @@ int pagingVidBoundary_test1() {
 	int result = PASS;
 	uint8_t * a;
 	// kernel memory address - 1 addr before start
-	a = (uint8_t*) VIDEO_ADDR-1; 
+	a = (uint8_t*) PHYS_TO_VIRT(VIDEO_ADDR)-1; 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -263,7 +299,7 @@ int pagingVidBoundary_test2() {
 	int result = PASS;
 	uint8_t * a;
 	// kernel memory address - 1 addr after end
-	a = (uint8_t*) (VIDEO_ADDR+PAGE_SIZE); 
+	a = (uint8_t*) PHYS_TO_VIRT(VIDEO_ADDR+PAGE_SIZE); 
 	*a = 1;
 	*a = 5;
 	if(*a != 5) {
@@ -682,6 +718,1014 @@ int syscallExecute_test(const uint8_t* command) {
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+/* Frame Allocator Test
+*
+* Allocates and frees frames, checking alignment, bounds and the free count
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None (all frames are returned)
+* Coverage : frame_alloc, frame_free, frame_free_count
+* Files : frames
+*/
+int frame_alloc_test() {
+	TEST_HEADER;
+	uint32_t a, b;
+	uint32_t free_before = frame_free_count();
+
+	a = frame_alloc();
+	b = frame_alloc();
+	if (a == 0 || b == 0 || a == b) return FAIL;
+	if ((a % FRAME_SIZE) || (b % FRAME_SIZE)) return FAIL;
+	if (a < FRAME_POOL_START || b >= FRAME_POOL_END) return FAIL;
+	if (frame_free_count() != free_before - 2) return FAIL;
+
+	// frame pool is mapped above KERNEL_BASE for the kernel
+	*(uint32_t*)PHYS_TO_VIRT(a) = 0xECE391;
+	if (*(uint32_t*)PHYS_TO_VIRT(a) != 0xECE391) return FAIL;
+
+	frame_free(a);
+	frame_free(b);
+	frame_free(b);	// double free is ignored
+	if (frame_free_count() != free_before) return FAIL;
+
+	return PASS;
+}
+
+/* Frame Reference Test
+*
+* Checks that a shared frame is only freed by its last reference
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None (the frame is returned)
+* Coverage : frame_ref, frame_free
+* Files : frames
+*/
+int frame_ref_test() {
+	TEST_HEADER;
+	uint32_t a;
+	uint32_t free_before = frame_free_count();
+
+	a = frame_alloc();
+	if (a == 0) return FAIL;
+	frame_ref(a);	// now mapped twice
+
+	frame_free(a);
+	if (frame_free_count() != free_before - 1) return FAIL;
+	frame_free(a);
+	if (frame_free_count() != free_before) return FAIL;
+
+	return PASS;
+}
+
+
+/* Zero Pool Test
+*
+* Empties the pre-zeroed pool, refills one frame and checks each
+* allocation is counted as a hit or a miss and comes back cleared
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Prints the pool hit rate (the drained frames are freed)
+* Coverage : frame_alloc_zeroed, frame_zero_refill, frame_zero_counts, frame_zero_stats
+* Files : frames
+*/
+int zero_pool_test() {
+	TEST_HEADER;
+	static uint32_t taken[ZERO_POOL_SIZE];
+	uint32_t hits, misses, h, m, addr, i, n = 0;
+
+	frame_zero_counts(&hits, &misses);
+	while (n < ZERO_POOL_SIZE && (addr = frame_alloc_zeroed()) != 0)
+		taken[n++] = addr;
+	if (frame_alloc_zeroed() != 0) return FAIL;		// empty now
+	frame_zero_counts(&h, &m);
+	if (h != hits + n || m != misses + 1) return FAIL;
+
+	for (i = 0; i < n; i++) {
+		if (*(uint32_t*)PHYS_TO_VIRT(taken[i]) != 0) return FAIL;
+		frame_free(taken[i]);
+	}
+
+	frame_zero_refill();
+	if ((addr = frame_alloc_zeroed()) == 0) return FAIL;
+	for (i = 0; i < FRAME_SIZE / 4; i++)
+		if (((uint32_t*)PHYS_TO_VIRT(addr))[i] != 0) return FAIL;
+	frame_free(addr);
+	frame_zero_counts(&h, &m);
+	if (h != hits + n + 1 || m != misses + 1) return FAIL;
+	frame_zero_stats();
+
+	return PASS;
+}
+
+/* LZ Compression Test
+*
+* Compresses and decompresses pages of zeroes, repeated text and
+* incompressible bytes
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None
+* Coverage : lz_compress, lz_decompress
+* Files : zswap
+*/
+int lz_compress_test() {
+	TEST_HEADER;
+	static uint8_t page[ZSWAP_PAGE_SIZE], out[ZSWAP_PAGE_SIZE], packed[ZSWAP_MAX_LEN];
+	int32_t len;
+	uint32_t i, seed = 391;
+
+	// zero page
+	memset(page, 0, ZSWAP_PAGE_SIZE);
+	if ((len = lz_compress(page, packed, ZSWAP_MAX_LEN)) == -1) return FAIL;
+	if (lz_decompress(packed, len, out) == -1) return FAIL;
+	for (i = 0; i < ZSWAP_PAGE_SIZE; i++)
+		if (page[i] != out[i]) return FAIL;
+
+	// repeating text with a few changes
+	for (i = 0; i < ZSWAP_PAGE_SIZE; i++)
+		page[i] = "391OS> "[i % 7] + (i % 1000 == 0);
+	if ((len = lz_compress(page, packed, ZSWAP_MAX_LEN)) == -1) return FAIL;
+	if (lz_decompress(packed, len, out) == -1) return FAIL;
+	for (i = 0; i < ZSWAP_PAGE_SIZE; i++)
+		if (page[i] != out[i]) return FAIL;
+
+	// pseudo-random bytes don't fit in half a page
+	for (i = 0; i < ZSWAP_PAGE_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		page[i] = seed >> 16;
+	}
+	if (lz_compress(page, packed, ZSWAP_MAX_LEN) != -1) return FAIL;
+
+	return PASS;
+}
+
+/* Zswap Test
+*
+* Stores a page of text in the compressed store, loads it back into
+* another frame and prints the store's ratio and fault latency
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Prints zswap stats (all frames are returned)
+* Coverage : zswap_store, zswap_load, zswap_print_stats
+* Files : zswap
+*/
+int zswap_test() {
+	TEST_HEADER;
+	uint32_t a, b, i;
+	int32_t handle, kept;
+	uint8_t* page;
+	uint32_t free_before = frame_free_count();
+
+	if ((a = frame_alloc()) == 0) return FAIL;
+	page = (uint8_t*)PHYS_TO_VIRT(a);
+	for (i = 0; i < ZSWAP_PAGE_SIZE; i++)
+		page[i] = "391OS> "[i % 7];
+	if ((handle = zswap_store(a, &kept)) == -1) return FAIL;
+	if (!kept)
+		frame_free(a);		// the data lives on in the pool
+
+	if ((b = frame_alloc()) == 0) return FAIL;
+	if (zswap_load(handle, b) != 0) return FAIL;
+	page = (uint8_t*)PHYS_TO_VIRT(b);
+	for (i = 0; i < ZSWAP_PAGE_SIZE; i++)
+		if (page[i] != "391OS> "[i % 7]) return FAIL;
+	if (zswap_load(handle, b) != -1) return FAIL;	// dropped by the first load
+	frame_free(b);
+	zswap_print_stats();
+
+	if (frame_free_count() != free_before) return FAIL;
+	return PASS;
+}
+
+/* test_process
+* Gives a pid an address space with the shell image loaded, as if it were
+* the running process
+* Inputs: pid - an unused pid (before the first shell only)
+* Outputs : 0 on success, -1 if the image couldn't be loaded
+* Side Effects : Switches to the pid's page directory and makes it cur_pid
+*/
+static int32_t test_process(int32_t pid) {
+	PCB_ADDR(pid)->pid = pid;
+	PCB_ADDR(pid)->mm_pid = pid;
+	PCB_ADDR(pid)->heap_brk = HEAP_START;
+	pid_status[pid] = 1;
+	cur_pid = pid;
+	if (paging_load(pid, (uint8_t*)"shell") == -1)
+		return -1;
+	paging_syscall(pid);
+	return 0;
+}
+
+/* test_process_end
+* Frees the address space of a test_process
+* Inputs: pid - pid given to test_process
+* Outputs : None
+* Side Effects : Switches back to the kernel's page directory
+*/
+static void test_process_end(int32_t pid) {
+	load_page_directory((uint32_t*)VIRT_TO_PHYS(page_directory.tables));
+	paging_free(pid);
+	pid_status[pid] = -1;
+	cur_pid = -1;
+}
+
+/* Stack Guard Test
+*
+* Faults in the top page of a process's stack and the lowest one it can
+* grow to, and checks a touch of the guard page below them is refused
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Prints "Stack overflow", uses pid 2 (before the first shell only)
+* Coverage : paging_fault, paging_pte
+* Files : paging
+*/
+int stack_guard_test() {
+	TEST_HEADER;
+	uint32_t* pte;
+	int32_t r1, r2, r3, ok;
+
+	if (test_process(2) == -1) {
+		test_process_end(2);
+		return FAIL;
+	}
+	r1 = paging_fault(STACK_TOP - 4, PF_USER | PF_WRITE);
+	r2 = paging_fault(STACK_GUARD + KB_4, PF_USER | PF_WRITE);		// lowest usable page
+	r3 = paging_fault(STACK_GUARD + KB_4 - 4, PF_USER | PF_WRITE);	// guard page
+	pte = paging_pte(2, STACK_GUARD, 0);
+	ok = (pte != NULL && !(*pte & PAGE_P) && (pte[1] & PAGE_P) && (pte[1] & PAGE_US));
+
+	*(volatile uint32_t*)(STACK_TOP - 4) = 391;		// mapped now, no fault
+	ok = ok && *(volatile uint32_t*)(STACK_TOP - 4) == 391;
+
+	test_process_end(2);
+	if (r1 != 0 || r2 != 0 || r3 != -1 || !ok) return FAIL;
+
+	return PASS;
+}
+
+/* Shared Memory Test
+*
+* Creates a segment in one process, attaches it in another and checks
+* both see each other's writes, that the pages are pinned, and that the
+* segment goes away with its last detach
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Uses pids 2 and 3 (before the first shell only)
+* Coverage : shm_create, shm_attach, shm_detach
+* Files : shm, paging
+*/
+int shm_test() {
+	TEST_HEADER;
+	uint8_t* name = (uint8_t*)(STACK_TOP - KB_4);	// names are read from user space
+	uint32_t* pte;
+	int32_t a, b, ok;
+
+	if (test_process(2) == -1 || paging_fault((uint32_t)name, PF_USER | PF_WRITE) == -1) {
+		test_process_end(2);
+		return FAIL;
+	}
+	strcpy((int8_t*)name, "shm_test");
+	if ((a = shm_create(name, KB_4 + 1)) == -1) {		// rounded up to two pages
+		test_process_end(2);
+		return FAIL;
+	}
+	((uint32_t*)a)[KB_4 / 4] = 391;
+	ok = shm_create(name, KB_4) == -1;		// name taken
+
+	if (test_process(3) == -1 || paging_fault((uint32_t)name, PF_USER | PF_WRITE) == -1) {
+		test_process_end(3);
+		test_process_end(2);		// detaches the segment too
+		return FAIL;
+	}
+	strcpy((int8_t*)name, "shm_test");
+	b = shm_attach(name);
+	if (b != -1) {
+		pte = paging_pte(3, b, 0);
+		ok = ok && ((uint32_t*)b)[KB_4 / 4] == 391 &&
+			(*pte & PAGE_PINNED) && !(*pte & PAGE_SHARED);
+		((uint32_t*)b)[0] = 17;
+		ok = ok && shm_detach((void*)b) == 0 && shm_detach((void*)b) == -1;
+	}
+	test_process_end(3);
+
+	paging_syscall(2);
+	cur_pid = 2;
+	ok = ok && ((uint32_t*)a)[0] == 17 && shm_detach((void*)a) == 0;
+	ok = ok && shm_attach(name) == -1;		// gone with its last process
+	test_process_end(2);
+	if (b == -1 || !ok) return FAIL;
+
+	return PASS;
+}
+
+/* Swap Test
+*
+* Writes a page out to swap and reads it back, then swaps it out again
+* under a process's page table entry and faults it back in
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Needs a swap disk (qemu -hdb), uses pid 2 (before the
+*                first shell only)
+* Coverage : swap_out, swap_in, paging_fault
+* Files : swap, paging
+*/
+int swap_test() {
+	TEST_HEADER;
+	uint32_t a, i, addr = STACK_TOP - KB_4;
+	uint32_t* page;
+	uint32_t* pte;
+	int32_t slot, again, ok;
+
+	if ((a = frame_alloc()) == 0) return FAIL;
+	page = (uint32_t*)PHYS_TO_VIRT(a);
+	for (i = 0; i < SWAP_PAGE_SIZE / 4; i++)
+		page[i] = i * 391;
+	if ((slot = swap_out((uint32_t)page)) == -1) {
+		printf("No swap disk\n");
+		frame_free(a);
+		return FAIL;
+	}
+	memset(page, 0, SWAP_PAGE_SIZE);
+	ok = swap_in(slot, (uint32_t)page) == 0;
+	for (i = 0; i < SWAP_PAGE_SIZE / 4; i++)
+		if (page[i] != i * 391) ok = 0;
+	again = swap_out((uint32_t)page);		// the slot was released by swap_in
+	frame_free(a);
+	if (!ok || again != slot) {
+		swap_free(again);
+		return FAIL;
+	}
+
+	if (test_process(2) == -1 || (pte = paging_pte(2, addr, 1)) == NULL) {
+		swap_free(again);
+		test_process_end(2);
+		return FAIL;
+	}
+	*pte = again * KB_4;
+	*pte |= PAGE_SWAPPED;
+	ok = paging_fault(addr, PF_USER) == 0 && (*pte & PAGE_P);
+	for (i = 0; ok && i < SWAP_PAGE_SIZE / 4; i++)
+		if (((uint32_t*)addr)[i] != i * 391) ok = 0;
+	test_process_end(2);
+	if (!ok) return FAIL;
+
+	return PASS;
+}
+
+/* Higher Half Test
+*
+* Checks the kernel runs above KERNEL_BASE from a global, supervisor only
+* 4MB page, that nothing below KERNEL_BASE is mapped in the kernel's own
+* directory, and that a process's directory keeps the low kernel
+* addresses free for user space
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Uses pid 2 (before the first shell only)
+* Coverage : paging_init, paging_load, PHYS_TO_VIRT
+* Files : paging
+*/
+int higher_half_test() {
+	TEST_HEADER;
+	uint32_t kpde = page_directory.tables[KERNEL_PDE + KERNEL_ADDR / MB_4];
+	uint32_t i;
+	int32_t ok;
+
+	if ((uint32_t)higher_half_test < KERNEL_BASE || (uint32_t)&kpde < KERNEL_BASE) return FAIL;
+	if ((kpde & PAGE_MASK) != KERNEL_ADDR || !(kpde & PAGE_P) || !(kpde & PAGE_PS) ||
+		!(kpde & PAGE_G) || (kpde & PAGE_US)) return FAIL;
+	if (VIRT_TO_PHYS(PHYS_TO_VIRT(KERNEL_ADDR)) != KERNEL_ADDR) return FAIL;
+	for (i = 0; i < KERNEL_PDE; i++)
+		if (page_directory.tables[i] & PAGE_P) return FAIL;
+
+	if (test_process(2) == -1) {
+		test_process_end(2);
+		return FAIL;
+	}
+	// only the image is mapped, the kernel still reaches its data through its own half
+	ok = paging_pte(2, KERNEL_ADDR, 0) == NULL && paging_pte(2, KERNEL_BASE, 0) == NULL &&
+		*(volatile uint32_t*)&page_directory.tables[KERNEL_PDE + KERNEL_ADDR / MB_4] == kpde;
+	test_process_end(2);
+	if (!ok) return FAIL;
+
+	return PASS;
+}
+
+/* Run Queue Test
+*
+* Checks that the run queue hands processes back oldest first
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None (the queue must be empty, i.e. before the first shell)
+* Coverage : sched_enqueue, sched_dequeue
+* Files : scheduling
+*/
+int run_queue_test() {
+	TEST_HEADER;
+	int32_t i;
+
+	if (sched_dequeue() != -1) return FAIL;
+	for (i = 0; i < MAX_PROCESSES; i++)
+		sched_enqueue(i);
+	sched_enqueue(0);	// full, dropped
+	for (i = 0; i < MAX_PROCESSES; i++)
+		if (sched_dequeue() != i) return FAIL;
+	if (sched_dequeue() != -1) return FAIL;
+
+	return PASS;
+}
+
+/* Wait Queue Test
+*
+* Wakes an empty queue, then sleeps on the RTC queue (no process is
+* running, so the kernel itself waits for each interrupt)
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None
+* Coverage : sched_sleep, sched_wake, rtc_read
+* Files : scheduling, rtc
+*/
+int wait_queue_test() {
+	TEST_HEADER;
+	wait_queue wq = {0, 0};
+	uint32_t i;
+
+	// waking an empty queue only counts the wakeup
+	sched_wake(&wq);
+	if (wq.wakeups != 1 || wq.waiting != 0) return FAIL;
+
+	// rtc_read sleeps until the next RTC interrupt (2 Hz, about 2 seconds)
+	for (i = 0; i < 4; i++)
+		rtc_read(0, NULL, 0);
+
+	return PASS;
+}
+
+/* Idle Test
+*
+* Checks nothing is runnable before the first shell, then prints the
+* utilization counted so far (all of it idle or kernel init)
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Prints CPU utilization
+* Coverage : sched_runnable, sched_idle_stats
+* Files : scheduling
+*/
+int idle_test() {
+	TEST_HEADER;
+
+	if (sched_runnable() != 0) return FAIL;
+	if (sched_dequeue() != -1) return FAIL;
+	sched_idle_stats();
+
+	return PASS;
+}
+
+/* Fair Share Test
+*
+* Gives two fake processes the same CPU time at different nice levels and
+* checks the lower level falls behind in vruntime, so it is picked first
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Clobbers the scheduler state of pids 0 and 1 (before the
+*                first shell only)
+* Coverage : sched_fork, sched_charge, sched_dequeue
+* Files : scheduling
+*/
+int fair_share_test() {
+	TEST_HEADER;
+	int32_t i, j;
+
+	sched_fork(0, -1);
+	sched_fork(1, -1);
+	cur_pid = 1;
+	pid_status[1] = 1;
+	if (nice(5) != 0) return FAIL;
+	sched_fork(0, 1);		// inherits nice 5
+	cur_pid = 0;
+	pid_status[0] = 1;
+	if (nice(-10) != 0) return FAIL;	// now -5
+
+	// charge each one for the same stretch of busy waiting (not sleeping,
+	// there are no page directories to switch to)
+	for (i = 0; i < 2; i++) {
+		cur_pid = i;
+		sched_charge();
+		for (j = 0; j < 10000000; j++)
+			asm volatile("");
+		sched_charge();
+	}
+	cur_pid = -1;
+	pid_status[0] = -1;
+	pid_status[1] = -1;
+	sched_task_stats(0);
+	sched_task_stats(1);
+
+	sched_enqueue(1);
+	sched_enqueue(0);
+	if (sched_dequeue() != 0) return FAIL;
+	if (sched_dequeue() != 1) return FAIL;
+
+	return PASS;
+}
+
+/* Tickless Test
+*
+* Arms a one-shot slice, waits for its interrupt, then checks the PIT stays
+* quiet while nothing is running
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None
+* Coverage : pit_oneshot, pit_handler, sched_timer
+* Files : pit, scheduling
+*/
+int tickless_test() {
+	TEST_HEADER;
+	uint32_t count, i;
+
+	if (!TICKLESS) return PASS;
+	if (pit_armed()) return FAIL;	// nothing to preempt before the first shell
+
+	count = pit_interrupts();
+	pit_oneshot(SLICE_COUNT);
+	while (pit_interrupts() == count)
+		asm volatile("hlt");
+	if (pit_armed()) return FAIL;	// the scheduler didn't rearm it
+
+	// about two seconds of RTC interrupts, no PIT ones
+	count = pit_interrupts();
+	for (i = 0; i < 4; i++)
+		rtc_read(0, NULL, 0);
+	if (pit_interrupts() != count) return FAIL;
+
+	return PASS;
+}
+
+/* Context Switch Benchmark
+*
+* Times round trips through context_switch and prints cycles per switch
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Prints the result
+* Coverage : context_switch, sched_bench
+* Files : pcb, scheduling
+*/
+int context_switch_bench() {
+	TEST_HEADER;
+	uint32_t cycles = sched_bench(100000);
+
+	printf("context switch: %d cycles\n", cycles);
+	if (cycles == 0) return FAIL;
+
+	return PASS;
+}
+
+static uint8_t pipe_data[3 * KB_4];
+static uint8_t pipe_out[3 * KB_4];
+
+/* pipe_test_rounds
+ * Body of the pipe test, runs as pid 2
+ * Returns 1 if every round trip matched and end of file was seen
+ */
+static int pipe_test_rounds() {
+	int32_t i, got, n;
+
+	// two passes, so the second one wraps around the ring
+	for (n = 0; n < 2; n++) {
+		if (pipe_write(3, pipe_data, 1000) != 1000) return 0;
+		if (pipe_write(3, pipe_data + 1000, 3 * KB_4 - 1000) != 3 * KB_4 - 1000) return 0;
+		for (got = 0; got < 3 * KB_4; got += i) {
+			if ((i = pipe_read(2, pipe_out + got, 777)) <= 0) return 0;
+		}
+		for (i = 0; i < 3 * KB_4; i++)
+			if (pipe_out[i] != pipe_data[i]) return 0;
+	}
+
+	pipe_close_write(3);
+	if (pipe_read(2, pipe_out, 1) != 0) return 0;	// end of file
+	pipe_close_read(2);
+	return 1;
+}
+
+/* Pipe Test
+*
+* Pushes data through a pipe in uneven chunks that cross buffer pages,
+* then checks end of file and that closing both ends frees the pipe
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Uses the PCB of pid 2 (before the first shell only)
+* Coverage : pipe_create, pipe_attach, pipe_read, pipe_write, pipe close
+* Files : pipe
+*/
+int pipe_test() {
+	TEST_HEADER;
+	int32_t idx, i, ok;
+
+	for (i = 0; i < 3 * KB_4; i++)
+		pipe_data[i] = i % 251;
+	if ((idx = pipe_create()) == -1) return FAIL;
+	PCB_ADDR(2)->mm_pid = 2;
+	pipe_attach(2, 2, idx, PIPE_READ_END);
+	pipe_attach(2, 3, idx, PIPE_WRITE_END);
+
+	cur_pid = 2;
+	ok = pipe_test_rounds();
+	cur_pid = -1;
+	if (!ok) return FAIL;
+
+	if (pipe_create() != idx) return FAIL;		// freed, so handed out again
+	pipe_release(idx);
+	return PASS;
+}
+
+/* Thread Test
+*
+* Checks futex argument checking, that a wake with no sleepers wakes
+* nobody, and that a killed thread is dropped from the run queue
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Uses the PCB of pid 2 (before the first shell only)
+* Coverage : futex, sched_remove
+* Files : thread, scheduling
+*/
+int thread_test() {
+	TEST_HEADER;
+	int32_t r1, r2, r3;
+
+	PCB_ADDR(2)->mm_pid = 2;
+	cur_pid = 2;
+	r1 = futex((uint32_t*)KERNEL_BASE, FUTEX_WAKE, 1);			// kernel address
+	r2 = futex((uint32_t*)(PROGRAM_IMAGE_ADDR + 2), FUTEX_WAKE, 1);	// unaligned
+	r3 = futex((uint32_t*)PROGRAM_IMAGE_ADDR, 5, 0);				// bad op
+	if (r1 != -1 || r2 != -1 || r3 != -1) {
+		cur_pid = -1;
+		return FAIL;
+	}
+	r1 = futex((uint32_t*)PROGRAM_IMAGE_ADDR, FUTEX_WAKE, 1);
+	cur_pid = -1;
+	if (r1 != 0) return FAIL;
+
+	sched_enqueue(3);
+	sched_enqueue(4);
+	sched_enqueue(5);
+	sched_remove(4);
+	if (sched_dequeue() != 3 || sched_dequeue() != 5 || sched_dequeue() != -1) return FAIL;
+
+	return PASS;
+}
+
+/* Waitpid Test
+*
+* Checks that waitpid collects only the caller's halted children, frees
+* their pids, and returns 0 with WNOHANG while one still runs
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Uses the PCBs of pids 2-5 (before the first shell only)
+* Coverage : waitpid
+* Files : systemcall
+*/
+int waitpid_test() {
+	TEST_HEADER;
+	int32_t r1, r2, r3, r4, r5;
+
+	PCB_ADDR(2)->mm_pid = 2;
+	PCB_ADDR(3)->waiter = 2;
+	PCB_ADDR(3)->exit_status = 256;
+	PCB_ADDR(4)->waiter = 2;
+	PCB_ADDR(5)->waiter = -1;
+	pid_status[2] = 1;
+	pid_status[3] = PID_ZOMBIE;
+	pid_status[4] = 1;
+	pid_status[5] = 1;
+	cur_pid = 2;
+
+	r1 = waitpid(5, NULL, WNOHANG);			// not spawned by pid 2
+	r2 = waitpid(MAX_PROCESSES, NULL, 0);	// bad pid
+	r3 = waitpid(-1, (int32_t*)KERNEL_BASE, WNOHANG);	// kernel address
+	r4 = waitpid(-1, NULL, WNOHANG);		// collects pid 3
+	r5 = waitpid(-1, NULL, WNOHANG);		// pid 4 still runs
+
+	cur_pid = -1;
+	pid_status[2] = -1;
+	pid_status[4] = -1;
+	pid_status[5] = -1;
+	if (r1 != -1 || r2 != -1 || r3 != -1) return FAIL;
+	if (r4 != 3 || pid_status[3] != -1 || r5 != 0) return FAIL;
+
+	return PASS;
+}
+
+/* Execute Link Test
+*
+* Links a process executed by a spawned one (a background job) and one
+* executed by the terminal's foreground process, checks each gets its
+* caller as parent and only the second takes over the terminal
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Uses the PCBs of pids 2-5 and terminal 0 (before the
+*                first shell only)
+* Coverage : execute_link
+* Files : systemcall
+*/
+int execute_link_test() {
+	TEST_HEADER;
+	terminal saved = terminals[0];
+	int32_t r1, r2, r3, ok;
+
+	PCB_ADDR(2)->pid = 2;		// the shell, in the foreground
+	PCB_ADDR(3)->pid = 3;		// a job it spawned
+	PCB_ADDR(4)->tid = 0;
+	PCB_ADDR(5)->tid = 0;
+	pid_status[2] = 1;
+	pid_status[3] = 1;
+	terminals[0].pid = 2;
+	terminals[0].pcb = PCB_ADDR(2);
+	terminals[0].running_processes = 1;
+
+	cur_pid = 3;
+	r1 = execute_link(4);
+	ok = PCB_ADDR(4)->parent == PCB_ADDR(3) && PCB_ADDR(3)->child == PCB_ADDR(4) &&
+		terminals[0].pid == 2 && terminals[0].pcb == PCB_ADDR(2) &&
+		terminals[0].running_processes == 1;
+
+	cur_pid = 2;
+	r2 = execute_link(5);
+	ok = ok && PCB_ADDR(5)->parent == PCB_ADDR(2) && terminals[0].pid == 5 &&
+		terminals[0].pcb == PCB_ADDR(5) && terminals[0].running_processes == 2;
+
+	pid_status[2] = -1;			// a halting shell's replacement has no parent
+	terminals[0].pid = 2;
+	r3 = execute_link(5);
+	ok = ok && PCB_ADDR(5)->parent == NULL && terminals[0].pid == 5;
+
+	cur_pid = -1;
+	pid_status[3] = -1;
+	terminals[0] = saved;
+	if (r1 != 0 || r2 != 0 || r3 != -1 || !ok) return FAIL;
+
+	return PASS;
+}
+
+/* Signal Test
+*
+* Checks set_handler argument checking, that a handler keeps a signal from
+* being fatal, that nothing is delivered on a return to the kernel, and
+* that sigreturn fails outside a handler
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Uses the PCB of pid 2 (before the first shell only)
+* Coverage : set_handler, sigreturn, signal_check, signal_fatal
+* Files : signal
+*/
+int signal_test() {
+	TEST_HEADER;
+	hw_context ctx;
+	int32_t r1, r2, r3, r4, fatal1, fatal2;
+
+	if (sizeof(hw_context) != 17 * 4) return FAIL;	// layout the user handler sees
+
+	PCB_ADDR(2)->mm_pid = 2;
+	pid_status[2] = 1;
+	cur_pid = 2;
+	signal_reset(2);
+
+	r1 = set_handler(NUM_SIGNALS, (void*)PROGRAM_IMAGE_ADDR);	// bad signal
+	r2 = set_handler(SIG_SEGFAULT, (void*)KERNEL_BASE);			// kernel address
+	signal_send(2, SIG_INTERRUPT);
+	fatal1 = signal_fatal(2);
+	r3 = set_handler(SIG_INTERRUPT, (void*)PROGRAM_IMAGE_ADDR);
+	fatal2 = signal_fatal(2);
+
+	ctx.cs = KERNEL_CS;
+	ctx.eip = 0;
+	signal_check(&ctx);		// returning to the kernel, stays pending
+	r4 = sigreturn();		// no handler running
+
+	signal_reset(2);
+	pid_status[2] = -1;
+	cur_pid = -1;
+	if (r1 != -1 || r2 != -1 || r3 != 0 || r4 != -1) return FAIL;
+	if (fatal1 != 1 || fatal2 != 0 || ctx.eip != 0) return FAIL;
+
+	return PASS;
+}
+
+/* SMP Test
+*
+* Checks the boot CPU's per-CPU state, that every CPU in the MP table came
+* up with its own APIC id, and that cur_pid is per CPU
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None
+* Coverage : smp_bsp_init, smp_boot, this_cpu
+* Files : smp
+*/
+int smp_test() {
+	TEST_HEADER;
+	uint32_t i, j;
+
+	if (this_cpu() != &cpus[CPU_BSP] || this_cpu()->self != this_cpu() || this_cpu()->tss != &tss)
+		return FAIL;
+	for (i = 0; i < num_cpus; i++) {
+		if (!cpus[i].online || cpus[i].id != i) return FAIL;
+		for (j = 0; j < i; j++)
+			if (cpus[j].apic_id == cpus[i].apic_id) return FAIL;
+	}
+	if (cur_pid != -1 || (num_cpus > 1 && cpus[1].pid != -1)) return FAIL;
+	printf("%d CPU(s) online\n", num_cpus);
+
+	return PASS;
+}
+
+/* APIC Timer Test
+*
+* Checks the calibration against the PIT, arms a one-shot count on this
+* CPU's timer and waits for its interrupt, then checks it stays stopped
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Prints the timer rate
+* Coverage : apic_timer_init, apic_timer_oneshot, apic_timer_handler, sched_timer
+* Files : apic, scheduling
+*/
+int apic_timer_test() {
+	TEST_HEADER;
+	uint32_t count;
+
+	if (!apic_timer_ready()) return PASS;	// scheduling on the PIT
+	printf("local APIC timer: %d counts per ms\n", apic_timer_rate());
+	if (apic_timer_armed()) return FAIL;	// nothing to preempt before the first shell
+
+	count = this_cpu()->timer_interrupts;
+	apic_timer_oneshot(1000);
+	while (this_cpu()->timer_interrupts == count)
+		asm volatile("hlt");
+	if (apic_timer_armed()) return FAIL;	// the scheduler didn't rearm it
+	if (this_cpu()->timer_interrupts != count + 1) return FAIL;
+
+	return PASS;
+}
+
+/* Lock Test
+*
+* Takes and lets go of a spinlock, with and without interrupts, and a
+* mutex nobody else wants, then prints the contention of every lock
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : Prints the lock statistics
+* Coverage : spin_lock, spin_trylock, spin_lock_irqsave, mutex_lock, lock_stats_print
+* Files : lock
+*/
+int lock_test() {
+	TEST_HEADER;
+	static spinlock test_lock = SPINLOCK_INIT("test");
+	static mutex test_mutex = MUTEX_INIT("test mutex");
+	uint32_t flags, inner;
+
+	spin_lock(&test_lock);
+	if (!test_lock.locked || spin_trylock(&test_lock)) return FAIL;
+	spin_unlock(&test_lock);
+	if (!spin_trylock(&test_lock)) return FAIL;
+	spin_unlock(&test_lock);
+
+	spin_lock_irqsave(&test_lock, flags);
+	cli_and_save(inner);
+	if (inner & EFLAGS_IF) return FAIL;		// interrupts stay off while it's held
+	spin_unlock_irqrestore(&test_lock, flags);
+	if (test_lock.locked) return FAIL;
+
+	mutex_lock(&test_mutex);
+	if (!test_mutex.locked || test_mutex.owner != cur_pid) return FAIL;
+	mutex_unlock(&test_mutex);
+	if (test_mutex.locked) return FAIL;
+
+#if LOCK_STATS
+	if (test_lock.acquired != 3 || test_lock.contended != 0) return FAIL;
+#endif
+	lock_stats_print();
+
+	return PASS;
+}
+
+static volatile uint32_t timer_fired;	// timer_test's callback count
+
+/* timer_test_func
+ * Callback of timer_test, counts how often it fired
+ */
+static void timer_test_func(uint32_t data) {
+	timer_fired += data;
+}
+
+/* Timer Test
+*
+* Starts a short timer and waits for it, cancels one on the same slot and
+* one far enough away to sit two levels up the wheel
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None
+* Coverage : timer_add, timer_cancel, timer_run, wheel cascading
+* Files : timer, pit
+*/
+int timer_test() {
+	TEST_HEADER;
+	static timer short_timer, cancelled, far;
+	uint32_t start;
+
+	timer_fired = 0;
+	timer_add(&far, 100000, timer_test_func, 100);			// 10000 ticks, level 2
+	timer_add(&cancelled, 3 * TIMER_TICK_MS, timer_test_func, 10);
+	timer_add(&short_timer, 3 * TIMER_TICK_MS, timer_test_func, 1);
+	if (!timer_pending(&far) || !timer_pending(&short_timer) || !timer_waiting()) return FAIL;
+	timer_cancel(&cancelled);
+	if (timer_pending(&cancelled)) return FAIL;
+
+	start = timer_ticks();
+	while (timer_pending(&short_timer))
+		asm volatile("hlt");
+	if (timer_ticks() - start < 2) return FAIL;		// fired early (the first tick may be partial)
+	if (timer_fired != 1) return FAIL;				// the cancelled one fired too
+
+	timer_cancel(&far);
+	if (timer_pending(&far) || timer_waiting()) return FAIL;
+
+	return PASS;
+}
+
+/* Real-Time Test
+*
+* Puts a process in the real-time class and checks it is dequeued before a
+* fair one queued first, and that opening the RTC starts its jitter
+* measurement afresh (reads can't be measured without a process to sleep)
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None
+* Coverage : rtprio, sched_order, sched_dequeue, rtc_open, rtc_jitter_get
+* Files : scheduling, rtc
+*/
+int rt_test() {
+	TEST_HEADER;
+	rtc_jitter j;
+
+	if (rtprio(1) != -1) return FAIL;		// no calling process
+	sched_fork(0, -1);
+	sched_fork(1, -1);
+	cur_pid = 1;
+	if (rtprio(RT_PRIO_MAX + 1) != -1 || rtprio(-1) != -1) return FAIL;
+	if (rtprio(5) != 0) return FAIL;
+
+	rtc_open(NULL);
+	cur_pid = -1;
+	if (rtc_jitter_get(1, &j) != 0 || j.samples != 0 || j.freq == 0) return FAIL;
+	if (rtc_jitter_get(MAX_PROCESSES, &j) != -1) return FAIL;
+
+	sched_enqueue(0);
+	sched_enqueue(1);		// level with 0 on vruntime, but real-time
+	if (sched_dequeue() != 1) return FAIL;
+	if (sched_dequeue() != 0) return FAIL;
+
+	cur_pid = 1;
+	rtprio(0);
+	cur_pid = -1;
+	return PASS;
+}
+
+/* Rusage Test
+*
+* Charges a made-up process for two ticks of user time, then checks they
+* went to utime only and that getrusage rejects a kernel buffer
+* Inputs: None
+* Outputs : PASS / FAIL
+* Side Effects : None
+* Coverage : sched_fork, sched_acct, sched_usage, getrusage
+* Files : scheduling, timer
+*/
+int rusage_test() {
+	TEST_HEADER;
+	rusage u;
+	uint32_t flags, start, stime;
+	int32_t ok;
+
+	if (timer_tick_kcycles() == 0) return FAIL;	// timer_init hasn't run
+	sched_fork(3, -1);
+	if (sched_usage(3)->utime != 0 || sched_usage(3)->nvcsw != 0) return FAIL;
+
+	cli_and_save(flags);
+	cur_pid = 3;
+	pid_status[3] = 1;
+	sched_acct(ACCT_KERNEL);			// kernel time up to now
+	stime = sched_usage(3)->stime;
+	start = rdtsc_kcycles();
+	while (rdtsc_kcycles() - start < 2 * timer_tick_kcycles())
+		;
+	sched_acct(ACCT_USER);
+	cur_pid = -1;
+	restore_flags(flags);
+
+	ok = sched_usage(3)->utime >= 2 && sched_usage(3)->stime == stime &&
+		getrusage(3, &u) == -1;		// not a user buffer
+	pid_status[3] = -1;
+	if (!ok) return FAIL;
+	if (getrusage(MAX_PROCESSES, &u) != -1) return FAIL;
+
+	return PASS;
+}
 
 /* Test suite entry point */
 void launch_tests()
@@ -710,6 +1754,7 @@ void launch_tests()
 	// TEST_OUTPUT("Negative Pointer Test", negPointer_test());
 	// TEST_OUTPUT("Paging Kernel Boundary Test (Start)", pagingKernelBoundary_test1());
 	// TEST_OUTPUT("Paging Kernel Boundary Test (End)", pagingKernelBoundary_test2());
+	// TEST_OUTPUT("Paging Low Kernel Test", pagingLowKernel_test());
 	// TEST_OUTPUT("Paging Video Mem Boundary Test (Start)", pagingVidBoundary_test1());
 	// TEST_OUTPUT("Paging Video Mem Boundary Test (End)", pagingVidBoundary_test2());
 
@@ -739,4 +1784,34 @@ void launch_tests()
 		TEST_OUTPUT("Terminal Test", terminal_test());
 	}
 	*/
+
+	/********** Memory tests **********/
+	// TEST_OUTPUT("Frame Allocator Test", frame_alloc_test());
+	// TEST_OUTPUT("Frame Reference Test", frame_ref_test());
+	// TEST_OUTPUT("Zero Pool Test", zero_pool_test());
+	// TEST_OUTPUT("LZ Compression Test", lz_compress_test());
+	// TEST_OUTPUT("Zswap Test", zswap_test());
+	// TEST_OUTPUT("Stack Guard Test", stack_guard_test());
+	// TEST_OUTPUT("Shared Memory Test", shm_test());
+	// TEST_OUTPUT("Swap Test", swap_test());
+	// TEST_OUTPUT("Higher Half Test", higher_half_test());
+
+	/********** Scheduler tests **********/
+	// TEST_OUTPUT("Run Queue Test", run_queue_test());
+	// TEST_OUTPUT("Wait Queue Test", wait_queue_test());
+	// TEST_OUTPUT("Idle Test", idle_test());
+	// TEST_OUTPUT("Fair Share Test", fair_share_test());
+	// TEST_OUTPUT("Tickless Test", tickless_test());
+	// TEST_OUTPUT("Context Switch Benchmark", context_switch_bench());
+	// TEST_OUTPUT("Pipe Test", pipe_test());
+	// TEST_OUTPUT("Thread Test", thread_test());
+	// TEST_OUTPUT("Waitpid Test", waitpid_test());
+	// TEST_OUTPUT("Execute Link Test", execute_link_test());
+	// TEST_OUTPUT("Signal Test", signal_test());
+	// TEST_OUTPUT("SMP Test", smp_test());
+	// TEST_OUTPUT("APIC Timer Test", apic_timer_test());
+	// TEST_OUTPUT("Lock Test", lock_test());
+	// TEST_OUTPUT("Timer Test", timer_test());
+	// TEST_OUTPUT("Real-Time Test", rt_test());
+	// TEST_OUTPUT("Rusage Test", rusage_test());
 }
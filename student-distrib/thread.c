@@ -0,0 +1,151 @@
+/* thread.c - Functionality for threads and futexes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "thread.h"
+#include "lib.h"
+#include "paging.h"
+#include "scheduling.h"
+#include "syscallasm.h"
+#include "signal.h"
+
+static uint32_t* futex_addr[MAX_PROCESSES];     // address each pid sleeps on, NULL if none
+static wait_queue futex_wait[MAX_PROCESSES];    // one queue per pid, so a wake can pick
+
+static void thread_start(void);
+
+/* clone
+ * Starts a thread in the current process
+ * Inputs: entry - function the thread runs, called as entry(arg)
+ *         stack - top of the thread's user stack
+ *         arg - argument for entry
+ * Outputs: pid of the thread on success, -1 on failure
+ * Effects: the thread shares the address space, heap, shared memory and
+ *          file descriptors of the process; it ends with halt (returning
+ *          from entry faults) and is killed when the process halts
+ */
+int32_t clone(void* entry, void* stack, void* arg) {
+	PCB* mm = MM_PCB(cur_pid);
+	uint32_t* sp = (uint32_t*)stack;
+	uint32_t flags;
+	int32_t pid, i;
+	PCB* pcb;
+
+	if ((uint32_t)entry < PROGRAM_IMAGE_ADDR || (uint32_t)entry >= KERNEL_BASE)
+		return -1;
+	if ((uint32_t)sp < PROGRAM_IMAGE_ADDR + 8 || (uint32_t)sp > KERNEL_BASE || ((uint32_t)sp & 0x3))
+		return -1;
+
+	// cdecl frame for entry: return address (none) and arg
+	sp[-1] = (uint32_t)arg;
+	sp[-2] = 0;
+
+	cli_and_save(flags);
+	if ((pid = pid_claim()) == -1) {
+		restore_flags(flags);
+		return -1;
+	}
+
+	pcb = PCB_ADDR(pid);
+	pcb->pid = pid;
+	pcb->tid = mm->tid;
+	pcb->mm_pid = mm->pid;
+	pcb->detached = 1;
+	pcb->waiter = -1;
+	pcb->eip = (uint32_t)entry;
+	pcb->user_esp = (uint32_t)(sp - 2);
+	pcb->exe_args[0] = '\0';
+	memcpy(pcb->name, mm->name, PCB_NAME_SIZE);
+	for (i = 0; i < FDA_SIZE; i++)
+		pcb->file_array[i].flags = NOT_IN_USE;	// the process's table is used
+	futex_addr[pid] = NULL;
+	signal_reset(pid);
+
+	sched_fork(pid, cur_pid);
+	sched_start(pid, thread_start);
+	restore_flags(flags);
+	return pid;
+}
+
+/* thread_start
+ * First code a thread runs, on its own kernel stack
+ * Inputs: none
+ * Outputs: none
+ * Effects: enters entry in user space, never returns
+ */
+static void thread_start(void) {
+	PCB* pcb = PCB_ADDR(cur_pid);
+
+	iret_thread(pcb->eip, pcb->user_esp);
+}
+
+/* futex
+ * Sleeps on or wakes a user address, the building block of user locks
+ * Inputs: addr - 4 byte aligned user address
+ *         op - FUTEX_WAIT or FUTEX_WAKE
+ *         val - FUTEX_WAIT: value *addr must still hold to sleep
+ *               FUTEX_WAKE: most threads to wake
+ * Outputs: FUTEX_WAIT: 0 once woken, -1 if *addr didn't hold val
+ *          FUTEX_WAKE: number of threads woken
+ *          -1 for a bad address or op
+ * Effects: only threads of the same process meet on an address
+ */
+int32_t futex(uint32_t* addr, int32_t op, uint32_t val) {
+	int32_t mm = PCB_ADDR(cur_pid)->mm_pid;
+	uint32_t flags;
+	int32_t pid, woken = 0;
+
+	if ((uint32_t)addr < PROGRAM_IMAGE_ADDR || (uint32_t)addr > KERNEL_BASE - 4 || ((uint32_t)addr & 0x3))
+		return -1;
+
+	cli_and_save(flags);
+	switch (op) {
+	case FUTEX_WAIT:
+		// checked with interrupts off, so a wake can't come in between
+		if (*addr != val) {
+			woken = -1;
+			break;
+		}
+		futex_addr[cur_pid] = addr;
+		while (futex_addr[cur_pid] == addr)
+			sched_sleep(&futex_wait[cur_pid]);
+		break;
+	case FUTEX_WAKE:
+		for (pid = 0; pid < MAX_PROCESSES && woken < (int32_t)val; pid++) {
+			if (futex_addr[pid] != addr || pid_status[pid] != 1 || PCB_ADDR(pid)->mm_pid != mm)
+				continue;
+			futex_addr[pid] = NULL;
+			sched_wake(&futex_wait[pid]);
+			woken++;
+		}
+		break;
+	default:
+		woken = -1;
+		break;
+	}
+	restore_flags(flags);
+	return woken;
+}
+
+/* thread_kill_all
+ * Kills the threads of a process that is halting
+ * Inputs: pid - the process (not one of its threads)
+ * Outputs: none
+ * Effects: the threads are taken off the run queue and wait queues and
+ *          their pids freed; they never run again
+ */
+void thread_kill_all(int32_t pid) {
+	uint32_t flags;
+	int32_t i;
+
+	cli_and_save(flags);
+	for (i = 0; i < MAX_PROCESSES; i++) {
+		if (i == pid || pid_status[i] != 1 || PCB_ADDR(i)->mm_pid != pid)
+			continue;
+		pid_status[i] = -1;
+		futex_addr[i] = NULL;
+		futex_wait[i].waiting = 0;
+		sched_remove(i);
+	}
+	restore_flags(flags);
+}
@@ -0,0 +1,21 @@
+/* thread.h - Defines for threads and futexes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _THREAD_H
+#define _THREAD_H
+
+#include "types.h"
+#include "systemcall.h"
+
+#define FUTEX_WAIT  0   // sleep if *addr still holds val
+#define FUTEX_WAKE  1   // wake up to val threads sleeping on addr
+
+/* system calls 17-18 */
+int32_t clone(void* entry, void* stack, void* arg);
+int32_t futex(uint32_t* addr, int32_t op, uint32_t val);
+
+/* kills the other threads of a halting process */
+void thread_kill_all(int32_t pid);
+
+#endif
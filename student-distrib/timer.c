@@ -0,0 +1,335 @@
+/* timer.c - Functionality for kernel timers and sleep
+ * vim:ts=4 noexpandtab
+ */
+
+#include "timer.h"
+#include "lib.h"
+#include "pit.h"
+#include "lock.h"
+#include "scheduling.h"
+#include "systemcall.h"
+#include "signal.h"
+
+static timer* wheel[WHEEL_LEVELS][WHEEL_SIZE];	// pending timers, each slot a list
+static uint32_t wheel_ticks = 0;		// next tick the wheel fires the slot of
+static uint32_t now_ticks = 0;			// ticks since timer_init, from the TSC
+static uint32_t last_kcycles;			// rdtsc_kcycles at the start of tick now_ticks
+static uint32_t kcycles_per_tick = 0;	// 0 until calibrated
+static uint32_t pending = 0;			// timers on the wheel
+static spinlock timer_lock = SPINLOCK_INIT("timer");	// guards all of the above
+
+static timer sleep_timers[MAX_PROCESSES];		// one per pid, for sleep
+static wait_queue sleep_wait[MAX_PROCESSES];
+
+static void timer_advance(void);
+static void wheel_add(timer* t);
+static void wheel_unlink(timer* t);
+static uint32_t wheel_cascade(uint32_t level);
+static void sleep_expire(uint32_t pid);
+
+/* timer_init
+ * Calibrates the time stamp counter the wheel keeps time with
+ * Inputs: none
+ * Outputs: none
+ * Effects: counts TSC cycles over TIMER_CALIBRATE_US of PIT channel 2;
+ *          ticks are counted from then on
+ * PIT interrupts only come while a timer is pending and a slice can stop
+ * one early, so time comes from the TSC and the interrupts just make the
+ * wheel catch up with it.
+ */
+void timer_init(void) {
+	uint32_t flags, start;
+
+	cli_and_save(flags);
+	start = rdtsc_kcycles();
+	pit_delay(TIMER_CALIBRATE_US);
+	kcycles_per_tick = (rdtsc_kcycles() - start) * TIMER_TICK_MS / (TIMER_CALIBRATE_US / 1000);
+	if (kcycles_per_tick == 0)
+		kcycles_per_tick = 1;
+	last_kcycles = rdtsc_kcycles();
+	restore_flags(flags);
+}
+
+/* timer_advance
+ * Brings now_ticks up to date with the TSC
+ * Inputs: none
+ * Outputs: none
+ * Effects: an empty wheel skips straight to now
+ * Call with timer_lock held.
+ */
+static void timer_advance(void) {
+	uint32_t elapsed;
+
+	if (kcycles_per_tick == 0)
+		return;
+	elapsed = (rdtsc_kcycles() - last_kcycles) / kcycles_per_tick;
+	now_ticks += elapsed;
+	last_kcycles += elapsed * kcycles_per_tick;
+	if (pending == 0)
+		wheel_ticks = now_ticks;
+}
+
+/* wheel_add
+ * Files a timer in the slot of its expiry
+ * Inputs: t - timer, not on the wheel
+ * Outputs: none
+ * Effects: a timer already due goes in the next slot to fire, one
+ *          further than WHEEL_MAX_TICKS away is brought in to it
+ * Call with timer_lock held.
+ */
+static void wheel_add(timer* t) {
+	uint32_t ahead = t->expires - wheel_ticks;
+	uint32_t level, slot;
+
+	if ((int32_t)ahead < 0) {
+		ahead = 0;
+		t->expires = wheel_ticks;
+	}
+	else if (ahead > WHEEL_MAX_TICKS) {
+		ahead = WHEEL_MAX_TICKS;
+		t->expires = wheel_ticks + WHEEL_MAX_TICKS;
+	}
+
+	// lowest level whose slots still reach that far
+	for (level = 0; level < WHEEL_LEVELS - 1 && ahead >= (1 << ((level + 1) * WHEEL_BITS)); level++)
+		;
+	slot = (t->expires >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+	t->next = wheel[level][slot];
+	if (t->next != NULL)
+		t->next->pprev = &t->next;
+	wheel[level][slot] = t;
+	t->pprev = &wheel[level][slot];
+}
+
+/* wheel_unlink
+ * Takes a timer out of its slot
+ * Inputs: t - timer on the wheel
+ * Outputs: none
+ * Call with timer_lock held.
+ */
+static void wheel_unlink(timer* t) {
+	*t->pprev = t->next;
+	if (t->next != NULL)
+		t->next->pprev = t->pprev;
+	t->next = NULL;
+	t->pprev = NULL;
+}
+
+/* wheel_cascade
+ * Refiles the timers of a level's current slot in the levels below
+ * Inputs: level - 1 to WHEEL_LEVELS - 1
+ * Outputs: index of the slot, 0 when the level above is due as well
+ * Called on the first tick of each round of the level below, when all of
+ * the slot's timers are less than a round away.
+ * Call with timer_lock held.
+ */
+static uint32_t wheel_cascade(uint32_t level) {
+	uint32_t slot = (wheel_ticks >> (level * WHEEL_BITS)) & WHEEL_MASK;
+	timer* t = wheel[level][slot];
+	timer* next;
+
+	wheel[level][slot] = NULL;
+	for (; t != NULL; t = next) {
+		next = t->next;
+		wheel_add(t);
+	}
+	return slot;
+}
+
+/* timer_run
+ * Fires every timer that is due
+ * Inputs: none
+ * Outputs: none
+ * Effects: turns the wheel a slot per tick up to now, calling each expired
+ *          timer's func without timer_lock held (so it can add timers),
+ *          then keeps the PIT ticking if any are left
+ * Called from the PIT interrupt.
+ */
+void timer_run(void) {
+	uint32_t slot, level;
+	timer* t;
+
+	spin_lock(&timer_lock);		// interrupts are already disabled
+	timer_advance();
+	while (pending > 0 && (int32_t)(now_ticks - wheel_ticks) >= 0) {
+		slot = wheel_ticks & WHEEL_MASK;
+		if (slot == 0) {
+			for (level = 1; level < WHEEL_LEVELS && wheel_cascade(level) == 0; level++)
+				;
+		}
+		wheel_ticks++;
+
+		while ((t = wheel[0][slot]) != NULL) {
+			wheel_unlink(t);
+			pending--;
+			spin_unlock(&timer_lock);
+			t->func(t->data);
+			spin_lock(&timer_lock);
+		}
+	}
+	timer_arm();
+	spin_unlock(&timer_lock);
+}
+
+/* timer_arm
+ * Keeps the PIT interrupting while a timer is pending
+ * Inputs: none
+ * Outputs: none
+ * Effects: starts a tick if the PIT is stopped; a slice already counting
+ *          down (see sched_timer) does instead
+ * Call with interrupts disabled.
+ */
+void timer_arm(void) {
+	if (pending > 0 && !pit_armed())
+		pit_oneshot(TIMER_TICK_COUNT);
+}
+
+/* timer_add
+ * Starts a timer, restarting it if it is pending
+ * Inputs: t - timer, zeroed before its first use
+ *         ms - milliseconds until it fires, rounded up to a tick
+ *         func - what to call then, from the PIT interrupt
+ *         data - argument for func
+ * Outputs: none
+ * Effects: O(1), the slot follows from the expiry
+ */
+void timer_add(timer* t, uint32_t ms, void (*func)(uint32_t data), uint32_t data) {
+	uint32_t flags;
+
+	spin_lock_irqsave(&timer_lock, flags);
+	if (t->pprev != NULL) {
+		wheel_unlink(t);
+		pending--;
+	}
+	timer_advance();
+	t->func = func;
+	t->data = data;
+	t->expires = now_ticks + ms / TIMER_TICK_MS + (ms % TIMER_TICK_MS != 0);
+	wheel_add(t);
+	pending++;
+	timer_arm();
+	spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/* timer_cancel
+ * Stops a timer before it fires
+ * Inputs: t - timer
+ * Outputs: none
+ * Effects: O(1); none if it isn't pending
+ */
+void timer_cancel(timer* t) {
+	uint32_t flags;
+
+	spin_lock_irqsave(&timer_lock, flags);
+	if (t->pprev != NULL) {
+		wheel_unlink(t);
+		pending--;
+	}
+	spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/* timer_pending
+ * Inputs: t - timer
+ * Outputs: 1 if it is waiting to fire, 0 once it fired or was cancelled
+ */
+uint32_t timer_pending(timer* t) {
+	return t->pprev != NULL;
+}
+
+/* timer_waiting
+ * Inputs: none
+ * Outputs: 1 if any timer is pending, so the PIT has to keep ticking
+ */
+uint32_t timer_waiting(void) {
+	return pending != 0;
+}
+
+/* timer_ticks
+ * Inputs: none
+ * Outputs: TIMER_TICK_MS ticks since timer_init
+ */
+uint32_t timer_ticks(void) {
+	uint32_t flags, ticks;
+
+	spin_lock_irqsave(&timer_lock, flags);
+	timer_advance();
+	ticks = now_ticks;
+	spin_unlock_irqrestore(&timer_lock, flags);
+	return ticks;
+}
+
+/* timer_kcycles_us
+ * Converts a TSC interval to time
+ * Inputs: kcycles - interval in rdtsc_kcycles units
+ * Outputs: microseconds, 0 before timer_init
+ */
+uint32_t timer_kcycles_us(uint32_t kcycles) {
+	uint32_t tick_us = TIMER_TICK_MS * 1000;
+
+	if (kcycles_per_tick == 0)
+		return 0;
+	// whole ticks and the rest apart, so neither product overflows
+	return kcycles / kcycles_per_tick * tick_us + kcycles % kcycles_per_tick * tick_us / kcycles_per_tick;
+}
+
+/* timer_tick_kcycles
+ * Inputs: none
+ * Outputs: rdtsc_kcycles units per tick, 0 before timer_init
+ */
+uint32_t timer_tick_kcycles(void) {
+	return kcycles_per_tick;
+}
+
+/* sleep
+ * Puts the calling process to sleep for a while
+ * Inputs: ms - milliseconds to sleep, rounded up to a tick
+ * Outputs: 0 once the time is up, -1 if a fatal signal cut it short or
+ *          there is no calling process
+ * Effects: other processes run meanwhile; no device is reprogrammed, so
+ *          any number of processes can sleep at once
+ */
+int32_t sleep(uint32_t ms) {
+	int32_t pid = cur_pid;
+	int32_t ret = 0;
+	uint32_t flags;
+
+	if (pid < 0)
+		return -1;
+	if (ms == 0)
+		return 0;
+
+	cli_and_save(flags);
+	timer_add(&sleep_timers[pid], ms, sleep_expire, pid);
+	while (timer_pending(&sleep_timers[pid])) {
+		if (signal_fatal(pid)) {
+			timer_cancel(&sleep_timers[pid]);
+			ret = -1;
+			break;
+		}
+		sched_sleep(&sleep_wait[pid]);
+	}
+	restore_flags(flags);
+	return ret;
+}
+
+/* sleep_expire
+ * Timer function of sleep
+ * Inputs: pid - sleeping process
+ * Outputs: none
+ */
+static void sleep_expire(uint32_t pid) {
+	sched_wake(&sleep_wait[pid]);
+}
+
+/* sleep_interrupt
+ * Wakes a process in sleep early, to give up for a pending signal
+ * Inputs: pid - process, -1 for none
+ * Outputs: none
+ * Effects: none unless it is sleeping
+ */
+void sleep_interrupt(int32_t pid) {
+	if (pid < 0 || pid >= MAX_PROCESSES || !timer_pending(&sleep_timers[pid]))
+		return;
+	sched_wake(&sleep_wait[pid]);
+}
@@ -0,0 +1,56 @@
+/* timer.h - Defines for kernel timers
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+
+/* the wheel advances one tick every TIMER_TICK_MS, driven by PIT interrupts
+ * while a timer is pending (the PIT stays stopped otherwise) */
+#define TIMER_TICK_MS       10
+#define TIMER_TICK_COUNT    11932   // PIT cycles per tick (1193182 / 100)
+
+/* hierarchical wheel: level 0 has a slot per tick for the next 64 ticks,
+ * each level above a slot per 64 slots of the one below, so a timer up to
+ * 2^24 ticks (about 46 hours) away is filed in O(1) and cascades down at
+ * most 3 times (Varghese and Lauck, like Linux's timer wheel) */
+#define WHEEL_LEVELS        4
+#define WHEEL_BITS          6
+#define WHEEL_SIZE          (1 << WHEEL_BITS)
+#define WHEEL_MASK          (WHEEL_SIZE - 1)
+#define WHEEL_MAX_TICKS     ((1 << (WHEEL_LEVELS * WHEEL_BITS)) - 1)
+
+/* the TSC is calibrated against PIT channel 2 over TIMER_CALIBRATE_US */
+#define TIMER_CALIBRATE_US  10000
+
+/* a timer, owned by the caller; pprev is NULL while it isn't pending */
+typedef struct timer_t {
+	struct timer_t* next;		// next in its wheel slot
+	struct timer_t** pprev;		// what points at it, so it unlinks in O(1)
+	uint32_t expires;			// tick it fires at
+	void (*func)(uint32_t data);	// called from the PIT interrupt, with interrupts disabled
+	uint32_t data;
+} timer;
+
+void timer_init(void);
+void timer_run(void);
+void timer_arm(void);
+
+/* timers - func runs once, about ms from now (rounded up to a tick) */
+void timer_add(timer* t, uint32_t ms, void (*func)(uint32_t data), uint32_t data);
+void timer_cancel(timer* t);
+uint32_t timer_pending(timer* t);
+uint32_t timer_waiting(void);
+uint32_t timer_ticks(void);
+uint32_t timer_kcycles_us(uint32_t kcycles);
+uint32_t timer_tick_kcycles(void);
+
+/* system call 21 */
+int32_t sleep(uint32_t ms);
+
+/* cuts a sleep short so a pending signal is delivered */
+void sleep_interrupt(int32_t pid);
+
+#endif
@@ -8,6 +8,10 @@
 
 #include "types.h"
 
+/* Virtual address the kernel is linked at (see kernel.ld), physical
+ * memory below 128MB is mapped from here */
+#define KERNEL_BASE 0xC0000000
+
 /* Segment selector values */
 #define KERNEL_CS   0x0010
 #define KERNEL_DS   0x0018
@@ -15,6 +19,10 @@
 #define USER_DS     0x002B
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
+#define KERNEL_PERCPU   0x0040
+
+/* Number of descriptors in the GDT, through KERNEL_PERCPU */
+#define GDT_ENTRIES 9
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
@@ -118,6 +126,8 @@ extern uint16_t ldt_desc;
 extern uint32_t ldt_size;
 extern seg_desc_t ldt_desc_ptr;
 extern seg_desc_t gdt_ptr;
+extern seg_desc_t gdt[GDT_ENTRIES];
+extern seg_desc_t percpu_desc_ptr;
 extern uint32_t ldt;
 
 extern uint32_t tss_size;
@@ -187,6 +197,17 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Load the global descriptor table (GDT).  Like lidt, this macro takes
+ * the address of the 6-byte size and base address structure. */
+#define lgdt(desc)                      \
+do {                                    \
+    asm volatile ("lgdt (%0)"           \
+            :                           \
+            : "r" (desc)                \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
 /* Load the interrupt descriptor table (IDT).  This macro takes a 32-bit
  * address which points to a 6-byte structure.  The 6-byte structure
  * (defined as "struct x86_desc" above) contains a 2-byte size field
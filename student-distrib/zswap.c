@@ -0,0 +1,321 @@
+/* zswap.c - Functionality for the compressed in-memory page store
+ * vim:ts=4 noexpandtab
+ */
+
+#include "zswap.h"
+#include "frames.h"
+#include "lib.h"
+#include "paging.h"
+
+static zswap_entry zswap_entries[ZSWAP_ENTRIES];
+static zswap_frame zswap_frames[ZSWAP_FRAMES];
+static uint16_t zswap_open = ZSWAP_NONE;        // pool frame new pages are appended to
+static uint8_t zswap_buf[ZSWAP_MAX_LEN];        // compressed page before it is placed
+static uint16_t lz_table[1 << LZ_HASH_BITS];    // last position of each hashed 4 byte sequence
+
+/* stats */
+static uint32_t zswap_stored = 0;       // pages in the store
+static uint32_t zswap_bytes = 0;        // compressed bytes in the store
+static uint32_t zswap_pool = 0;         // pool frames in use
+static uint32_t zswap_rejected = 0;     // pages that didn't compress well enough
+static uint32_t zswap_faults = 0;       // pages decompressed on fault
+static uint32_t zswap_cycles = 0;       // cycles spent decompressing (with zswap_cycle_count)
+static uint32_t zswap_cycle_count = 0;
+
+static int32_t lz_emit(uint8_t* dst, uint32_t* op, uint32_t max_len, const uint8_t* lit,
+		uint32_t lit_len, uint32_t offset, uint32_t match_len);
+
+/* zswap_init
+ * Initializes the store
+ * Inputs: none
+ * Outputs: none
+ * Effects: marks every entry and pool frame as free
+ */
+void zswap_init(void) {
+	uint32_t i;
+
+	for (i = 0; i < ZSWAP_ENTRIES; i++)
+		zswap_entries[i].frame = ZSWAP_NONE;
+	for (i = 0; i < ZSWAP_FRAMES; i++)
+		zswap_frames[i].addr = 0;
+	zswap_open = ZSWAP_NONE;
+}
+
+/* zswap_store
+ * Compresses a page into the store
+ * Inputs: addr - physical address of the page to store
+ *         kept - set to 1 if the frame became part of the pool and must not
+ *                be freed, 0 if the caller can free it
+ * Outputs: handle of the stored page, -1 if it doesn't compress or the store is full
+ * Effects: when the open pool frame is full, the page's own frame starts the
+ *          next one, so storing never needs a free frame
+ */
+int32_t zswap_store(uint32_t addr, int32_t* kept) {
+	zswap_frame* f;
+	uint32_t handle, idx;
+	int32_t len;
+
+	*kept = 0;
+	if ((len = lz_compress((const uint8_t*)PHYS_TO_VIRT(addr), zswap_buf, ZSWAP_MAX_LEN)) == -1) {
+		zswap_rejected++;
+		return -1;
+	}
+
+	for (handle = 0; handle < ZSWAP_ENTRIES; handle++) {
+		if (zswap_entries[handle].frame == ZSWAP_NONE)
+			break;
+	}
+	if (handle == ZSWAP_ENTRIES)
+		return -1;
+
+	if (zswap_open == ZSWAP_NONE || zswap_frames[zswap_open].used + len > ZSWAP_PAGE_SIZE) {
+		for (idx = 0; idx < ZSWAP_FRAMES; idx++) {
+			if (zswap_frames[idx].addr == 0)
+				break;
+		}
+		if (idx == ZSWAP_FRAMES)
+			return -1;
+		// the page is already compressed into zswap_buf, reuse its frame
+		zswap_frames[idx].addr = addr;
+		zswap_frames[idx].used = 0;
+		zswap_frames[idx].live = 0;
+		zswap_open = idx;
+		zswap_pool++;
+		*kept = 1;
+	}
+
+	f = &zswap_frames[zswap_open];
+	memcpy((void*)PHYS_TO_VIRT(f->addr + f->used), zswap_buf, len);
+	zswap_entries[handle].frame = zswap_open;
+	zswap_entries[handle].offset = f->used;
+	zswap_entries[handle].length = len;
+	f->used += len;
+	f->live++;
+
+	zswap_stored++;
+	zswap_bytes += len;
+	return handle;
+}
+
+/* zswap_load
+ * Decompresses a page out of the store
+ * Inputs: handle - handle returned by zswap_store
+ *         addr - physical address of the page to decompress into
+ * Outputs: 0 on success, -1 if the handle is invalid or the data is corrupt
+ * Effects: drops the page from the store on success
+ */
+int32_t zswap_load(uint32_t handle, uint32_t addr) {
+	zswap_entry* e;
+	uint32_t start = rdtsc();
+
+	if (handle >= ZSWAP_ENTRIES || zswap_entries[handle].frame == ZSWAP_NONE)
+		return -1;
+	e = &zswap_entries[handle];
+	if (lz_decompress((const uint8_t*)PHYS_TO_VIRT(zswap_frames[e->frame].addr + e->offset), e->length, (uint8_t*)PHYS_TO_VIRT(addr)) == -1)
+		return -1;
+	zswap_free(handle);
+
+	// halve both sums before they overflow, the average stays the same
+	if (zswap_cycles > 0x7FFFFFFF) {
+		zswap_cycles /= 2;
+		zswap_cycle_count /= 2;
+	}
+	zswap_cycles += rdtsc() - start;
+	zswap_cycle_count++;
+	zswap_faults++;
+	return 0;
+}
+
+/* zswap_free
+ * Drops a page from the store
+ * Inputs: handle - handle returned by zswap_store
+ * Outputs: none
+ * Effects: frees the pool frame once nothing in it is live
+ */
+void zswap_free(uint32_t handle) {
+	zswap_entry* e;
+	zswap_frame* f;
+
+	if (handle >= ZSWAP_ENTRIES || zswap_entries[handle].frame == ZSWAP_NONE)
+		return;
+	e = &zswap_entries[handle];
+	f = &zswap_frames[e->frame];
+
+	zswap_stored--;
+	zswap_bytes -= e->length;
+	if (--f->live == 0) {
+		frame_free(f->addr);
+		f->addr = 0;
+		zswap_pool--;
+		if (e->frame == zswap_open)
+			zswap_open = ZSWAP_NONE;
+	}
+	e->frame = ZSWAP_NONE;
+}
+
+/* zswap_print_stats
+ * Prints how well the store is doing
+ * Inputs: none
+ * Outputs: none
+ * Effects: prints nothing if the store was never used
+ */
+void zswap_print_stats(void) {
+	uint32_t ratio = 0, avg = 0;
+
+	if (zswap_stored == 0 && zswap_faults == 0)
+		return;
+	if (zswap_bytes)
+		ratio = zswap_stored * ZSWAP_PAGE_SIZE * 10 / zswap_bytes;	// in tenths
+	if (zswap_cycle_count)
+		avg = zswap_cycles / zswap_cycle_count;
+
+	printf("zswap: %d pages in %d frames (%d.%d:1), %d rejected, %d faults at %d cycles\n",
+		zswap_stored, zswap_pool, ratio / 10, ratio % 10, zswap_rejected, zswap_faults, avg);
+}
+
+/* lz_compress
+ * Compresses a page with a greedy LZ77 (LZ4 style sequences)
+ * Inputs: src - page to compress
+ *         dst - output buffer of max_len bytes
+ *         max_len - largest acceptable result
+ * Outputs: compressed size, -1 if it would exceed max_len
+ * Each sequence is a token (literal length << 4 | match length - 4), the
+ * literals, then a 2 byte offset back to the match. Lengths of 15 continue
+ * in following bytes, each 255 meaning more follow. The last sequence has
+ * literals only.
+ */
+int32_t lz_compress(const uint8_t* src, uint8_t* dst, uint32_t max_len) {
+	uint32_t ip = 0, anchor = 0, op = 0;
+	uint32_t limit = ZSWAP_PAGE_SIZE - LZ_LAST_LITERALS;
+	uint32_t ref, hash, len;
+
+	memset(lz_table, 0, sizeof(lz_table));
+	while (ip + LZ_MIN_MATCH <= limit) {
+		hash = (*(uint32_t*)(src + ip) * LZ_HASH_MUL) >> (32 - LZ_HASH_BITS);
+		ref = lz_table[hash];
+		lz_table[hash] = ip;
+		// an empty or colliding slot is caught by comparing the bytes
+		if (ref >= ip || *(uint32_t*)(src + ref) != *(uint32_t*)(src + ip)) {
+			ip++;
+			continue;
+		}
+
+		len = LZ_MIN_MATCH;
+		while (ip + len < limit && src[ref + len] == src[ip + len])
+			len++;
+		if (lz_emit(dst, &op, max_len, src + anchor, ip - anchor, ip - ref, len) == -1)
+			return -1;
+		ip += len;
+		anchor = ip;
+	}
+
+	if (lz_emit(dst, &op, max_len, src + anchor, ZSWAP_PAGE_SIZE - anchor, 0, 0) == -1)
+		return -1;
+	return op;
+}
+
+/* lz_decompress
+ * Decompresses a page written by lz_compress
+ * Inputs: src - compressed data
+ *         len - compressed size
+ *         dst - page to fill
+ * Outputs: 0 on success, -1 if the data doesn't decode to exactly one page
+ */
+int32_t lz_decompress(const uint8_t* src, uint32_t len, uint8_t* dst) {
+	uint32_t ip = 0, op = 0;
+	uint32_t token, lit, match, offset, b;
+
+	while (ip < len) {
+		token = src[ip++];
+
+		lit = token >> 4;
+		if (lit == LZ_NIBBLE_MAX) {
+			do {
+				if (ip >= len)
+					return -1;
+				b = src[ip++];
+				lit += b;
+			} while (b == LZ_BYTE_MAX);
+		}
+		if (ip + lit > len || op + lit > ZSWAP_PAGE_SIZE)
+			return -1;
+		memcpy(dst + op, src + ip, lit);
+		ip += lit;
+		op += lit;
+		if (ip >= len)
+			break;	// last sequence
+
+		if (ip + 2 > len)
+			return -1;
+		offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		match = token & LZ_NIBBLE_MAX;
+		if (match == LZ_NIBBLE_MAX) {
+			do {
+				if (ip >= len)
+					return -1;
+				b = src[ip++];
+				match += b;
+			} while (b == LZ_BYTE_MAX);
+		}
+		match += LZ_MIN_MATCH;
+		if (offset == 0 || offset > op || op + match > ZSWAP_PAGE_SIZE)
+			return -1;
+		// byte by byte, the match may overlap what it is copying
+		while (match--) {
+			dst[op] = dst[op - offset];
+			op++;
+		}
+	}
+
+	return (op == ZSWAP_PAGE_SIZE) ? 0 : -1;
+}
+
+/* lz_emit
+ * Appends one sequence to the compressed output
+ * Inputs: dst, op - output buffer and position in it (advanced)
+ *         max_len - size of the output buffer
+ *         lit, lit_len - literals preceding the match
+ *         offset, match_len - the match, match_len 0 for the last sequence
+ * Outputs: 0 on success, -1 if the sequence doesn't fit
+ */
+static int32_t lz_emit(uint8_t* dst, uint32_t* op, uint32_t max_len, const uint8_t* lit,
+		uint32_t lit_len, uint32_t offset, uint32_t match_len) {
+	uint32_t o = *op;
+	uint32_t m = match_len ? match_len - LZ_MIN_MATCH : 0;
+	uint32_t need = 1 + lit_len;
+	uint32_t n;
+
+	if (lit_len >= LZ_NIBBLE_MAX)
+		need += (lit_len - LZ_NIBBLE_MAX) / LZ_BYTE_MAX + 1;
+	if (match_len) {
+		need += 2;
+		if (m >= LZ_NIBBLE_MAX)
+			need += (m - LZ_NIBBLE_MAX) / LZ_BYTE_MAX + 1;
+	}
+	if (o + need > max_len)
+		return -1;
+
+	dst[o++] = ((lit_len < LZ_NIBBLE_MAX ? lit_len : LZ_NIBBLE_MAX) << 4) |
+		(m < LZ_NIBBLE_MAX ? m : LZ_NIBBLE_MAX);
+	if (lit_len >= LZ_NIBBLE_MAX) {
+		for (n = lit_len - LZ_NIBBLE_MAX; n >= LZ_BYTE_MAX; n -= LZ_BYTE_MAX)
+			dst[o++] = LZ_BYTE_MAX;
+		dst[o++] = n;
+	}
+	memcpy(dst + o, lit, lit_len);
+	o += lit_len;
+
+	if (match_len) {
+		dst[o++] = offset & 0xFF;
+		dst[o++] = offset >> 8;
+		if (m >= LZ_NIBBLE_MAX) {
+			for (n = m - LZ_NIBBLE_MAX; n >= LZ_BYTE_MAX; n -= LZ_BYTE_MAX)
+				dst[o++] = LZ_BYTE_MAX;
+			dst[o++] = n;
+		}
+	}
+
+	*op = o;
+	return 0;
+}
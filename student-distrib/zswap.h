@@ -0,0 +1,57 @@
+/* zswap.h - Defines for the compressed in-memory page store
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ZSWAP_H
+#define _ZSWAP_H
+
+#include "types.h"
+
+#define ZSWAP_PAGE_SIZE     4096
+#define ZSWAP_MAX_LEN       2048    // pages that don't compress at least 2:1 go to disk swap
+#define ZSWAP_ENTRIES       8192    // compressed pages that can be stored
+#define ZSWAP_FRAMES        2048    // pool frames holding compressed data (8 MB)
+#define ZSWAP_NONE          0xFFFF  // no pool frame
+
+/* LZ compressor */
+#define LZ_MIN_MATCH        4       // shortest match worth encoding
+#define LZ_LAST_LITERALS    5       // bytes at the end that are always literals
+#define LZ_HASH_BITS        12
+#define LZ_HASH_MUL         2654435761U
+#define LZ_NIBBLE_MAX       15      // length nibble that continues in extra bytes
+#define LZ_BYTE_MAX         255
+
+// compressed page, packed into a pool frame after the ones before it
+typedef struct zswap_entry_t {
+	uint16_t frame;     // index into the pool, ZSWAP_NONE if the entry is free
+	uint16_t offset;    // where the data starts in the pool frame
+	uint16_t length;    // compressed size
+	uint16_t reserved;
+} zswap_entry;
+
+// pool frame, filled front to back and freed once nothing in it is live
+typedef struct zswap_frame_t {
+	uint32_t addr;      // physical address, 0 if the slot is unused
+	uint16_t used;      // bytes handed out so far
+	uint16_t live;      // entries still stored in it
+} zswap_frame;
+
+/* resets the store */
+void zswap_init(void);
+
+/* compresses a page into the store, returns its handle or -1 if it doesn't fit
+ * kept is set when the page's frame was taken over by the pool */
+int32_t zswap_store(uint32_t addr, int32_t* kept);
+/* decompresses a page into addr and drops it from the store, 0 on success */
+int32_t zswap_load(uint32_t handle, uint32_t addr);
+/* drops a page from the store */
+void zswap_free(uint32_t handle);
+/* prints compression ratio and fault latency */
+void zswap_print_stats(void);
+
+/* LZ77 block compression of a 4 KB page, returns the compressed size or -1 if over max_len */
+int32_t lz_compress(const uint8_t* src, uint8_t* dst, uint32_t max_len);
+/* decompresses exactly one page, returns 0 on success and -1 on corrupt input */
+int32_t lz_decompress(const uint8_t* src, uint32_t len, uint8_t* dst);
+
+#endif
@@ -1,9 +1,16 @@
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include "ece391support.h"
@@ -64,14 +71,15 @@ _start:                                 \n\
 /* end of fake container function */
 }
 
-int32_t 
-ece391_execute (const uint8_t* command)
+/* forks a process running command, returns its pid or -1 */
+static pid_t
+start_program (const uint8_t* command)
 {
-    int status;
     uint8_t buf[1026];
     char* args[1024];
     uint8_t* scan;
     uint32_t n_arg;
+    pid_t pid;
 
     if (1023 < ece391_strlen (command))
 	return -1;
@@ -98,11 +106,17 @@ ece391_execute (const uint8_t* command)
 	}
     }
     args[n_arg] = NULL;
-    if (0 == fork ()) {
+    if (0 == (pid = fork ())) {
 	execv ((char*)buf, args);
         kill (getpid (), 9);
     }
-    (void)wait (&status);
+    return pid;
+}
+
+/* maps a host wait status to what halt would have returned */
+static int32_t
+halt_status (int status)
+{
     if (WIFEXITED (status))
         return WEXITSTATUS (status);
     if (9 == WTERMSIG (status))
@@ -110,6 +124,72 @@ ece391_execute (const uint8_t* command)
     return 256;
 }
 
+int32_t 
+ece391_execute (const uint8_t* command)
+{
+    int status;
+
+    if (-1 == start_program (command))
+        return -1;
+    (void)wait (&status);
+    return halt_status (status);
+}
+
+int32_t
+ece391_spawn (const uint8_t* command)
+{
+    return start_program (command);
+}
+
+int32_t
+ece391_waitpid (int32_t pid, int32_t* status, int32_t options)
+{
+    int host_status;
+    pid_t done;
+
+    done = waitpid (pid, &host_status, (options & WNOHANG) ? WNOHANG : 0);
+    if (done <= 0)
+        return done;
+    if (NULL != status)
+        *status = halt_status (host_status);
+    return done;
+}
+
+int32_t
+ece391_sleep (uint32_t ms)
+{
+    return (0 == usleep (ms * 1000)) ? 0 : -1;
+}
+
+int32_t
+ece391_rtprio (int32_t prio)
+{
+    /* the host scheduler decides, just check the argument */
+    return (prio < 0 || prio > 31) ? -1 : 0;
+}
+
+int32_t
+ece391_getrusage (int32_t pid, struct ece391_rusage* usage)
+{
+    struct rusage ru;
+
+    /* only the caller, the host has no way to look up another emulation */
+    if (-1 != pid || NULL == usage || 0 != getrusage (RUSAGE_SELF, &ru))
+        return -1;
+    usage->utime = (ru.ru_utime.tv_sec * 1000 + ru.ru_utime.tv_usec / 1000) / RUSAGE_TICK_MS;
+    usage->stime = (ru.ru_stime.tv_sec * 1000 + ru.ru_stime.tv_usec / 1000) / RUSAGE_TICK_MS;
+    usage->nvcsw = ru.ru_nvcsw;
+    usage->nivcsw = ru.ru_nivcsw;
+    usage->syscalls = 0;
+    usage->faults = ru.ru_minflt + ru.ru_majflt;
+    usage->nice = 0;
+    usage->rt_prio = 0;
+    usage->terminal = 0;
+    usage->resident = ru.ru_maxrss;     /* the peak, the host has no current figure */
+    usage->name[0] = '\0';
+    return 0;
+}
+
 int32_t 
 ece391_open (const uint8_t* filename)
 {
@@ -176,6 +256,141 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+void*
+ece391_sbrk (int32_t increment)
+{
+    return sbrk (increment);
+}
+
+#define SHM_SLOTS 4
+static void* shm_addr[SHM_SLOTS];
+static size_t shm_size[SHM_SLOTS];
+
+static void*
+shm_map (const uint8_t* name, uint32_t size, int32_t flags)
+{
+    char path[40];
+    struct stat st;
+    void* addr;
+    int fd, slot;
+
+    for (slot = 0; slot < SHM_SLOTS && shm_addr[slot] != NULL; slot++);
+    if (slot == SHM_SLOTS)
+        return (void*)-1;
+
+    snprintf (path, sizeof (path), "/ece391_%s", (const char*)name);
+    if (-1 == (fd = shm_open (path, flags, 0600)))
+        return (void*)-1;
+    if ((flags & O_CREAT) && -1 == ftruncate (fd, size)) {
+        close (fd);
+        return (void*)-1;
+    }
+    if (-1 == fstat (fd, &st)) {
+        close (fd);
+        return (void*)-1;
+    }
+    addr = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED)
+        return (void*)-1;
+
+    shm_addr[slot] = addr;
+    shm_size[slot] = st.st_size;
+    return addr;
+}
+
+void*
+ece391_shm_create (const uint8_t* name, uint32_t size)
+{
+    return shm_map (name, size, O_RDWR | O_CREAT | O_EXCL);
+}
+
+void*
+ece391_shm_attach (const uint8_t* name)
+{
+    return shm_map (name, 0, O_RDWR);
+}
+
+int32_t
+ece391_shm_detach (void* addr)
+{
+    int slot;
+
+    for (slot = 0; slot < SHM_SLOTS; slot++) {
+        if (shm_addr[slot] == addr && addr != NULL) {
+            munmap (addr, shm_size[slot]);
+            shm_addr[slot] = NULL;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int32_t
+ece391_pipe (int32_t* fds)
+{
+    int host_fds[2];
+
+    if (-1 == pipe (host_fds))
+        return -1;
+    fds[0] = host_fds[0];
+    fds[1] = host_fds[1];
+    return 0;
+}
+
+struct clone_start {
+    void (*fn)(void*);
+    void* arg;
+};
+
+static void*
+clone_start (void* p)
+{
+    struct clone_start start = *(struct clone_start*)p;
+
+    free (p);
+    start.fn (start.arg);
+    return NULL;
+}
+
+int32_t
+ece391_clone (void (*fn)(void*), void* stack, void* arg)
+{
+    static int32_t next_tid = 1;
+    struct clone_start* start;
+    pthread_t thread;
+
+    (void)stack;    /* pthreads allocate their own */
+    if (NULL == (start = malloc (sizeof (*start))))
+        return -1;
+    start->fn = fn;
+    start->arg = arg;
+    if (0 != pthread_create (&thread, NULL, clone_start, start)) {
+        free (start);
+        return -1;
+    }
+    pthread_detach (thread);
+    return next_tid++;
+}
+
+int32_t
+ece391_futex (int32_t* addr, int32_t op, int32_t val)
+{
+    long ret = syscall (SYS_futex, addr,
+                        (FUTEX_WAIT == op) ? FUTEX_WAIT_PRIVATE : FUTEX_WAKE_PRIVATE,
+                        val, NULL, NULL, 0);
+    return (ret < 0) ? -1 : (int32_t)ret;
+}
+
+int32_t
+ece391_nice (int32_t inc)
+{
+    errno = 0;
+    if (-1 == nice (inc) && errno != 0)
+        return -1;
+    return 0;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
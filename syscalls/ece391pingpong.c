@@ -11,6 +11,7 @@
 #define LOOPMAX BUFMAX-ENDING-1
 #define STARTCHAR 'A'
 #define ENDCHAR 'Z'
+#define FRAME_MS 30     // about the 32 Hz it used to set the RTC to
 
 int main ()
 {
@@ -18,9 +19,6 @@ int main ()
     int32_t j = 0;
     uint8_t curchar = STARTCHAR;
     uint8_t update = 1;
-    int ret_val;
-    int garbage;
-    int rtc_fd;
     uint8_t buf[BUFMAX];
     
     // Clear buffer
@@ -33,11 +31,6 @@ int main ()
     buf[BUFMAX-3]='|';
     buf[START]='|';
 
-    // Open and set RTC Frequency
-    rtc_fd = ece391_open((uint8_t*)"rtc");
-    ret_val = 32;
-    ret_val = ece391_write(rtc_fd, &ret_val, 4);
-
     while(1)
     {
 	// Move out
@@ -53,8 +46,8 @@ int main ()
 		buf[j] = curchar;
 		ece391_fdputs (1, buf);
 
-		// Wait for RTC tick
-		ece391_read(rtc_fd, &garbage, 4);
+		// Wait for the next frame
+		ece391_sleep(FRAME_MS);
 	}
 	
 	// Bounce back
@@ -70,8 +63,8 @@ int main ()
 		buf[j] = curchar;
 		ece391_fdputs (1, buf);
 
-		// Wait for RTC tick
-		ece391_read(rtc_fd, &garbage, 4);
+		// Wait for the next frame
+		ece391_sleep(FRAME_MS);
     	}
 
 	// Edge case on characters
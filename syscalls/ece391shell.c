@@ -5,13 +5,81 @@
 
 #define BUFSIZE 1024
 
+/* The kernel runs "a | b | c" as concurrent stages joined by pipes, each
+ * stage just has to name a program.  Returns -1 if one is empty. */
+static int32_t
+check_pipeline (const uint8_t* cmd)
+{
+    int32_t words = 0;
+
+    for (; '\0' != *cmd; cmd++) {
+        if ('|' == *cmd) {
+            if (0 == words)
+                return -1;
+            words = 0;
+        } else if (' ' != *cmd) {
+            words++;
+        }
+    }
+    return (0 == words) ? -1 : 0;
+}
+
+/* Prints "[pid] msg" and the status if it isn't -1. */
+static void
+job_report (int32_t pid, const char* msg, int32_t status)
+{
+    uint8_t num[12];
+
+    ece391_fdputs (1, (uint8_t*)"[");
+    ece391_fdputs (1, ece391_itoa (pid, num, 10));
+    ece391_fdputs (1, (uint8_t*)"] ");
+    ece391_fdputs (1, (uint8_t*)msg);
+    if (-1 != status) {
+        ece391_fdputs (1, (uint8_t*)" ");
+        ece391_fdputs (1, ece391_itoa (status, num, 10));
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* Strips a trailing '&' (and the spaces around it) from cmd, returns 1 if
+ * there was one: the command then runs as a background job. */
+static int32_t
+background_job (uint8_t* cmd)
+{
+    int32_t len = ece391_strlen (cmd);
+
+    while (len > 0 && ' ' == cmd[len - 1])
+        len--;
+    if (0 == len || '&' != cmd[len - 1])
+        return 0;
+    len--;
+    while (len > 0 && ' ' == cmd[len - 1])
+        len--;
+    cmd[len] = '\0';
+    return 1;
+}
+
+/* CTRL+C is meant for the program in the foreground, the shell keeps going. */
+static void
+interrupt_sighandler (int signum)
+{
+}
+
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, pid, bg;
     uint8_t buf[BUFSIZE];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
+    ece391_set_handler (INTERRUPT, interrupt_sighandler);
 
     while (1) {
+        /* report the background jobs that finished */
+        while (0 < (pid = ece391_waitpid (-1, &rval, WNOHANG))) {
+            if (256 == rval)
+                job_report (pid, "terminated by exception", -1);
+            else
+                job_report (pid, "done, status", rval);
+        }
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -22,8 +90,20 @@ int main ()
 	buf[cnt] = '\0';
 	if (0 == ece391_strcmp (buf, (uint8_t*)"exit"))
 	    return 0;
+	bg = background_job (buf);
 	if ('\0' == buf[0])
 	    continue;
+	if (0 != check_pipeline (buf)) {
+	    ece391_fdputs (1, (uint8_t*)"missing command in pipeline\n");
+	    continue;
+	}
+	if (bg) {
+	    if (-1 == (pid = ece391_spawn (buf)))
+	        ece391_fdputs (1, (uint8_t*)"no such command\n");
+	    else
+	        job_report (pid, "started", -1);
+	    continue;
+	}
 	rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
@@ -22,6 +22,78 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/* Moves the end of the heap by increment bytes and returns the old end
+ * ((void*)-1 on failure).  Pages are zero-filled on first touch. */
+extern void* ece391_sbrk (int32_t increment);
+
+/* Named shared memory (up to 1 MB, at most 16 attached per process).
+ * create makes a zeroed segment and attaches it, attach maps an existing
+ * one; both return its address ((void*)-1 on failure).  A segment is
+ * destroyed when the last process detaches from it (or halts). */
+extern void* ece391_shm_create (const uint8_t* name, uint32_t size);
+extern void* ece391_shm_attach (const uint8_t* name);
+extern int32_t ece391_shm_detach (void* addr);
+
+/* Adds inc to the caller's nice level (clamped to [-20, 19], lower gets
+ * more CPU).  Programs it executes inherit the level. */
+extern int32_t ece391_nice (int32_t inc);
+
+/* Creates a pipe, fds[0] reads what fds[1] writes.  Reads sleep until
+ * there is data and return 0 once every write end is closed; writes
+ * sleep while the 16 KB buffer is full. */
+extern int32_t ece391_pipe (int32_t* fds);
+
+/* Starts a thread running fn(arg) on the stack ending at stack (16-byte
+ * aligned top of memory the caller owns, e.g. from ece391_malloc).  It
+ * shares memory and files with the process and must end with
+ * ece391_halt; it dies when the process halts.  Returns its pid. */
+extern int32_t ece391_clone (void (*fn)(void*), void* stack, void* arg);
+
+/* FUTEX_WAIT sleeps while *addr == val (returns -1 at once if not);
+ * FUTEX_WAKE wakes up to val threads sleeping on addr. */
+#define FUTEX_WAIT  0
+#define FUTEX_WAKE  1
+extern int32_t ece391_futex (int32_t* addr, int32_t op, int32_t val);
+
+/* Starts command (a pipeline too) like execute but returns at once with
+ * the pid of its (last) process.  waitpid collects what it halted with
+ * (256 after an exception) for pid, or -1 for any spawned process; it
+ * returns the pid, -1 if there is none left to wait for, or 0 with
+ * WNOHANG if none has halted yet. */
+#define WNOHANG     1
+extern int32_t ece391_spawn (const uint8_t* command);
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+
+/* Sleeps for about ms milliseconds, rounded up to the kernel's 10 ms
+ * tick, without touching the RTC.  Returns 0, or -1 if a signal that
+ * kills the process cut it short. */
+extern int32_t ece391_sleep (uint32_t ms);
+
+/* Moves the caller to the real-time class at priority prio (1 to 31,
+ * higher first), or back to the fair class with 0.  A real-time process
+ * runs before every other one and gets the CPU as soon as the RTC read or
+ * sleep it waits in returns, so it should sleep between frames. */
+extern int32_t ece391_rtprio (int32_t prio);
+
+/* CPU usage of process pid (-1 for the caller), filled in by getrusage.
+ * Times are in 10 ms ticks.  Returns -1 if no process has that pid. */
+#define RUSAGE_TICK_MS  10
+#define RUSAGE_NAME_LEN 33
+struct ece391_rusage {
+    uint32_t utime;         /* ticks in user space */
+    uint32_t stime;         /* ticks in the kernel */
+    uint32_t nvcsw;         /* times it gave up the CPU to wait */
+    uint32_t nivcsw;        /* times it was preempted */
+    uint32_t syscalls;
+    uint32_t faults;        /* page faults */
+    int32_t nice;
+    uint32_t rt_prio;
+    uint32_t terminal;
+    uint32_t resident;      /* KB of memory mapped */
+    uint8_t name[RUSAGE_NAME_LEN];
+};
+extern int32_t ece391_getrusage (int32_t pid, struct ece391_rusage* usage);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
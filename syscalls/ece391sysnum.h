@@ -11,5 +11,18 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SBRK    11
+#define SYS_SHM_CREATE  12
+#define SYS_SHM_ATTACH  13
+#define SYS_SHM_DETACH  14
+#define SYS_NICE    15
+#define SYS_PIPE    16
+#define SYS_CLONE   17
+#define SYS_FUTEX   18
+#define SYS_SPAWN   19
+#define SYS_WAITPID 20
+#define SYS_SLEEP   21
+#define SYS_RTPRIO  22
+#define SYS_GETRUSAGE 23
 
 #endif /* ECE391SYSNUM_H */
@@ -0,0 +1,119 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUM_COLS    80
+#define NUM_ROWS    25
+#define ATTRIB      0x7
+#define MAX_PIDS    32          /* pids getrusage knows */
+#define REFRESH_MS  1000
+#define BUFSIZE     33
+
+static uint8_t* screen;
+static uint32_t last_ticks[MAX_PIDS];   /* utime + stime at the last refresh */
+
+static void put_str (int32_t row, int32_t col, int32_t width, const uint8_t* s);
+static void put_num (int32_t row, int32_t col, int32_t width, int32_t value);
+static void refresh (void);
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t i, rounds = 0;
+
+    /* optional argument: refreshes before it quits, forever without one */
+    if (0 == ece391_getargs (buf, BUFSIZE)) {
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            rounds = rounds * 10 + buf[i] - '0';
+    }
+    if (-1 == ece391_vidmap (&screen)) {
+        ece391_fdputs (1, (uint8_t*)"vidmap failed\n");
+        return 3;
+    }
+
+    for (i = 0; rounds == 0 || i < rounds; i++) {
+        refresh ();
+        if (0 != ece391_sleep (REFRESH_MS))
+            break;          /* CTRL+C */
+    }
+    return 0;
+}
+
+/* Draws a line per process, %CPU is over the last refresh */
+static void
+refresh (void)
+{
+    struct ece391_rusage u;
+    uint32_t ticks, cpu;
+    int32_t pid, row;
+
+    for (row = 0; row < NUM_ROWS; row++)
+        put_str (row, 0, NUM_COLS, (uint8_t*)"");
+    put_str (0, 0, NUM_COLS, (uint8_t*)"top - every second, CTRL+C quits; times in 10 ms ticks, RES in KB");
+    put_str (1, 0, NUM_COLS, (uint8_t*)
+        "PID  NAME       TTY  NI RT %CPU   RES   USER    SYS   VCSW  ICSW SYSCALLS FAULTS");
+
+    row = 2;
+    for (pid = 0; pid < MAX_PIDS; pid++) {
+        if (0 != ece391_getrusage (pid, &u)) {
+            last_ticks[pid] = 0;
+            continue;
+        }
+        ticks = u.utime + u.stime;
+        if (ticks < last_ticks[pid])
+            last_ticks[pid] = 0;    /* the pid went to another process */
+        cpu = (ticks - last_ticks[pid]) * RUSAGE_TICK_MS * 100 / REFRESH_MS;
+        last_ticks[pid] = ticks;
+        if (row >= NUM_ROWS)
+            continue;
+
+        put_num (row, 0, 3, pid);
+        put_str (row, 5, 10, u.name);
+        put_num (row, 16, 3, u.terminal);
+        put_num (row, 20, 3, u.nice);
+        put_num (row, 24, 2, u.rt_prio);
+        put_num (row, 27, 4, cpu);
+        put_num (row, 32, 5, u.resident);
+        put_num (row, 38, 6, u.utime);
+        put_num (row, 45, 6, u.stime);
+        put_num (row, 52, 6, u.nvcsw);
+        put_num (row, 59, 5, u.nivcsw);
+        put_num (row, 65, 8, u.syscalls);
+        put_num (row, 74, 6, u.faults);
+        row++;
+    }
+}
+
+/* Writes s at row, col, cut or padded with spaces to width characters */
+static void
+put_str (int32_t row, int32_t col, int32_t width, const uint8_t* s)
+{
+    uint8_t* cell = screen + ((row * NUM_COLS + col) << 1);
+    int32_t i;
+
+    for (i = 0; i < width && col + i < NUM_COLS; i++) {
+        cell[i << 1] = (*s != '\0') ? *s++ : ' ';
+        cell[(i << 1) + 1] = ATTRIB;
+    }
+}
+
+/* Writes value right-aligned in width characters */
+static void
+put_num (int32_t row, int32_t col, int32_t width, int32_t value)
+{
+    uint8_t buf[BUFSIZE];
+    uint8_t* digits = buf + 1;
+    int32_t len;
+
+    buf[0] = '-';
+    ece391_itoa ((value < 0) ? -value : value, digits, 10);
+    if (value < 0)
+        digits = buf;
+    len = ece391_strlen (digits);
+    if (len < width)
+        put_str (row, col, width - len, (uint8_t*)"");
+    else
+        len = width;
+    put_str (row, col + width - len, len, digits);
+}